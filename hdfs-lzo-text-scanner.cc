@@ -28,6 +28,7 @@
 #include "runtime/runtime-state.h"
 #include "runtime/hdfs-fs-cache.h"
 #include "util/debug-util.h"
+#include "util/hash-util.h"
 #include "util/hdfs-util.h"
 
 #include "gen-cpp/Descriptors_types.h"
@@ -39,10 +40,38 @@ using namespace std;
 
 DEFINE_bool(disable_lzo_checksums, true,
     "Disable internal checksum checking for Lzo compressed files, defaults true");
+DEFINE_string(lzo_trace_dir, "",
+    "If set, LZO scanners write per-block event timelines as Chrome trace-event JSON "
+    "to this directory, one file per fragment instance.");
+DEFINE_int32(lzo_steal_min_blocks, 16,
+    "A scanner that finishes its range steals blocks from a range of the same LZO "
+    "file that has at least this many blocks left to read. 0 disables stealing.");
+DEFINE_int64(lzo_boundary_block_bytes, 16L * 1024L * 1024L,
+    "Maximum decompressed bytes an LZO scan node keeps for reuse by the scanner of "
+    "the adjacent scan range. 0 disables sharing of boundary blocks.");
+DEFINE_bool(lzo_prefilter, false,
+    "Search decompressed LZO blocks for the literals of LIKE and string equality "
+    "predicates and skip parsing the records that do not contain them.");
+DEFINE_int32(lzo_sample_percent, 100,
+    "Percentage of the blocks of indexed LZO files to scan. Values below 100 make all "
+    "LZO scans on this impalad approximate and are meant for exploration only.");
+DEFINE_int32(lzo_sample_seed, 0,
+    "Seed used to pick the sampled LZO blocks. The same seed samples the same blocks.");
+DEFINE_bool(lzo_sample_systematic, false,
+    "Sample every n-th LZO block instead of a random subset of the blocks.");
+DEFINE_bool(lzo_incremental_scan, false,
+    "Scan only the records of indexed LZO files that were appended since the last "
+    "completed scan of the same split on this impalad. All LZO scans on this impalad, "
+    "whatever the query, then return only the rows added since the previous one.");
 
 // Suffix for index file: hdfs-filename.index
 const string HdfsLzoTextScanner::INDEX_SUFFIX = ".index";
 
+const string HdfsLzoTextScanner::BOUNDARY_BUDGET_KEY = "lzo:boundary-block-budget";
+
+// Protects the creation of the BoundaryBudget of a scan node.
+static mutex boundary_budget_lock;
+
 // The magic byte sequence at the beginning of an LZOP file.
 static const uint8_t LZOP_MAGIC[9] =
     { 0x89, 0x4c, 0x5a, 0x4f, 0x00, 0x0d, 0x0a, 0x1a, 0x0a };
@@ -61,14 +90,26 @@ namespace impala {
 
 HdfsLzoTextScanner::HdfsLzoTextScanner(HdfsScanNode* scan_node, RuntimeState* state)
     : HdfsTextScanner(scan_node, state),
+      header_(NULL),
+      range_registered_(false),
+      share_boundaries_(false),
+      start_boundary_(-1),
+      end_boundary_(-1),
       block_buffer_pool_(new MemPool(state->mem_limits())),
       block_buffer_len_(0),
       bytes_remaining_(0),
       past_eosr_(false),
       eos_read_(false),
+      skip_to_cursor_(false),
+      last_block_read_(false),
       only_parsing_header_(false),
-      disable_checksum_(FLAGS_disable_lzo_checksums) {
+      disable_checksum_(FLAGS_disable_lzo_checksums),
+      metrics_(LzoMetrics::GetInstance(state->exec_env()->metrics())),
+      past_eosr_offset_(0),
+      prefilter_bytes_counter_(NULL) {
   decompress_timer_ = ADD_TIMER(scan_node->runtime_profile(), "DecompressionTime");
+  boundary_blocks_reused_counter_ = ADD_COUNTER(scan_node->runtime_profile(),
+      "LzoBoundaryBlocksReused", TCounterType::UNIT);
 }
 
 HdfsLzoTextScanner::~HdfsLzoTextScanner() {
@@ -77,10 +118,33 @@ HdfsLzoTextScanner::~HdfsLzoTextScanner() {
 }
 
 Status HdfsLzoTextScanner::Close() {
+  if (trace_ != NULL) {
+    Status status = trace_->Flush(FLAGS_lzo_trace_dir);
+    if (!status.ok()) LOG(WARNING) << status.GetErrorMsg();
+  }
   AttachPool(block_buffer_pool_.get());
   AddFinalRowBatch();
+  DiskIoMgr::ScanRange* extra_range = NULL;
+  if (header_ != NULL && !only_parsing_header_) {
+    if (past_eosr_) {
+      scan_stats_.past_eosr_bytes = stream_->file_offset() - past_eosr_offset_;
+    }
+    scan_stats_.decompress_time_ns = decompress_watch_.ElapsedTime();
+    metrics_->Update(scan_stats_);
+    UnregisterRange();
+    // A scanner that stops early passes the blocks it did not get to.
+    if (!past_eosr_) end_boundary_ = EndBoundary();
+    PassBoundary(&start_boundary_);
+    PassBoundary(&end_boundary_);
+    lock_guard<mutex> l(header_->lock);
+    if (header_->extra_ranges.count(stream_->scan_range()) > 0) {
+      extra_range = stream_->scan_range();
+    }
+  }
   context_->Close();
-  if (!only_parsing_header_) {
+  if (header_ != NULL && !only_parsing_header_) {
+    CompleteSplits(extra_range == NULL ? 1 : 0, extra_range);
+  } else if (!only_parsing_header_) {
     scan_node_->RangeComplete(THdfsFileFormat::LZO_TEXT, THdfsCompression::NONE);
   }
   scan_node_->ReleaseCodegenFn(THdfsFileFormat::LZO_TEXT, codegen_fn_);
@@ -96,30 +160,193 @@ Status HdfsLzoTextScanner::ProcessSplit() {
     // This is the initial scan range just to parse the header
     only_parsing_header_ = true;
     header_ = state_->obj_pool()->Add(new LzoFileHeader());
+    header_->boundary_budget = GetBoundaryBudget();
     // Parse the header and read the index file.
     RETURN_IF_ERROR(ReadHeader());
-    RETURN_IF_ERROR(ReadIndexFile());
+    RETURN_IF_ERROR(ReadBlockOffsets());
 
     // Header is parsed, set the metadata in the scan node.
     scan_node_->SetFileMetadata(stream_->filename(), header_);
     return IssueFileRanges(stream_->filename());
   }
   only_parsing_header_ = false;
+  if (!FLAGS_lzo_trace_dir.empty()) {
+    trace_.reset(
+        new LzoTraceBuffer(stream_->filename(), state_->fragment_instance_id()));
+  }
+  if (FLAGS_lzo_prefilter) {
+    prefilter_.reset(LzoBlockPrefilter::Create(scan_node_, state_,
+        context_->partition_descriptor()));
+    if (prefilter_ != NULL) {
+      prefilter_bytes_counter_ = ADD_COUNTER(scan_node_->runtime_profile(),
+          "LzoPrefilterBytesDropped", TCounterType::BYTES);
+    }
+  }
 
   if (stream_->scan_range()->offset() == 0) {
     Status status;
     stream_->SkipBytes(header_->header_size_, &status);
   } else {
     DCHECK(!header_->offsets.empty());
-    RETURN_IF_ERROR(FindFirstBlock());
+    const vector<int64_t>& offsets = header_->offsets;
+    DiskIoMgr::ScanRange* range = stream_->scan_range();
+    vector<int64_t>::const_iterator first =
+        lower_bound(offsets.begin(), offsets.end(), range->offset());
+    if (first == offsets.end() || *first >= range->offset() + range->len()) {
+      // No block and so no record starts in this range. The records of the block
+      // that spans it are read by the range that block starts in.
+      VLOG_FILE << "No block starts in range of: " << stream_->filename()
+                << " @" << range->offset();
+      return StealBlocks();
+    }
+    RETURN_IF_ERROR(FindFirstBlock(false));
+    // The range before the cursor is not scanned.
+    skip_to_cursor_ = header_->incremental &&
+        stream_->scan_range()->offset() == SplitCursor(GetSplit());
   }
 
+  RegisterRange();
   RETURN_IF_ERROR(HdfsTextScanner::ProcessSplit());
+  UnregisterRange();
+  if (header_->incremental) AdvanceCursor();
+
+  // This scanner is done, help out with the rest of the file.
+  RETURN_IF_ERROR(StealBlocks());
   return Status::OK;
 }
 
+void HdfsLzoTextScanner::RegisterRange() {
+  if (header_->offsets.empty() || header_->sampled) return;
+  const vector<int64_t>& offsets = header_->offsets;
+  DiskIoMgr::ScanRange* range = stream_->scan_range();
+  int64_t next = lower_bound(offsets.begin(), offsets.end(), stream_->file_offset())
+      - offsets.begin();
+  int64_t end = lower_bound(offsets.begin(), offsets.end(),
+      range->offset() + range->len()) - offsets.begin();
+  active_range_.blocks = PackBlocks(next, end);
+
+  // A range in which no block starts reads only the first block of the next range
+  // and leaves it to that range and the previous one.
+  share_boundaries_ = FLAGS_lzo_boundary_block_bytes > 0 && next < end;
+  if (share_boundaries_ && range->offset() != 0 && !skip_to_cursor_) {
+    start_boundary_ = offsets[next];
+  }
+
+  // The cursor of an incremental scan is kept per split, so each split must be
+  // scanned by a single range.
+  if (FLAGS_lzo_steal_min_blocks <= 0 || header_->incremental) return;
+  lock_guard<mutex> l(header_->lock);
+  header_->active_ranges.push_back(&active_range_);
+  range_registered_ = true;
+}
+
+void HdfsLzoTextScanner::UnregisterRange() {
+  if (!range_registered_) return;
+  lock_guard<mutex> l(header_->lock);
+  header_->active_ranges.remove(&active_range_);
+  range_registered_ = false;
+}
+
+bool HdfsLzoTextScanner::AtRangeEnd() {
+  if (stream_->eosr()) return true;
+  if (!range_registered_) return false;
+  const vector<int64_t>& offsets = header_->offsets;
+  int64_t next = lower_bound(offsets.begin(), offsets.end(), stream_->file_offset())
+      - offsets.begin();
+  while (true) {
+    int64_t blocks = active_range_.blocks;
+    // A range that ends past the last known block ends at eosr.
+    int64_t end = EndBlock(blocks);
+    if (next >= end && end < offsets.size()) return true;
+    if (next == NextBlock(blocks)) return false;
+    if (__sync_bool_compare_and_swap(
+        &active_range_.blocks, blocks, PackBlocks(next, end))) {
+      return false;
+    }
+  }
+}
+
+Status HdfsLzoTextScanner::StealBlocks() {
+  if (header_->offsets.empty() || FLAGS_lzo_steal_min_blocks <= 0) return Status::OK;
+  const vector<int64_t>& offsets = header_->offsets;
+  HdfsFileDesc* file_desc = scan_node_->GetFileDesc(stream_->filename());
+  ScanRangeMetadata* metadata =
+      reinterpret_cast<ScanRangeMetadata*>(file_desc->splits[0]->meta_data());
+  int64_t steal_offset;
+  int64_t steal_end;
+  vector<DiskIoMgr::ScanRange*> ranges;
+  {
+    lock_guard<mutex> l(header_->lock);
+    // Find the range with the most blocks that have not been started.
+    ActiveRange* victim = NULL;
+    int64_t most_blocks = 0;
+    for (list<ActiveRange*>::iterator it = header_->active_ranges.begin();
+         it != header_->active_ranges.end(); ++it) {
+      int64_t blocks = (*it)->blocks;
+      int64_t num_blocks = EndBlock(blocks) - NextBlock(blocks) - 1;
+      if (num_blocks > most_blocks) {
+        victim = *it;
+        most_blocks = num_blocks;
+      }
+    }
+    if (victim == NULL || most_blocks < FLAGS_lzo_steal_min_blocks) return Status::OK;
+
+    // Leave the first half to the victim. It will stop at the first stolen block and
+    // read past it to finish its last record. The victim keeps reading while the
+    // range is lowered, so retry until its position did not change in between.
+    int64_t blocks;
+    int64_t steal_block;
+    do {
+      blocks = victim->blocks;
+      int64_t first = NextBlock(blocks) + 1;
+      int64_t num_blocks = EndBlock(blocks) - first;
+      if (num_blocks < FLAGS_lzo_steal_min_blocks) return Status::OK;
+      steal_block = first + num_blocks / 2;
+    } while (!__sync_bool_compare_and_swap(&victim->blocks, blocks,
+        PackBlocks(NextBlock(blocks), steal_block)));
+    steal_offset = offsets[steal_block];
+    steal_end = EndBlock(blocks) < offsets.size() ?
+        offsets[EndBlock(blocks)] : file_desc->file_length;
+
+    ranges.push_back(scan_node_->AllocateScanRange(stream_->filename(),
+        steal_end - steal_offset, steal_offset, metadata->partition_id, -1));
+    header_->extra_ranges.insert(ranges.back());
+  }
+
+  VLOG_FILE << "Stealing blocks of " << stream_->filename()
+            << " from @" << steal_offset << " to @" << steal_end;
+  if (trace_ != NULL) {
+    trace_->AddInstant(LzoTraceBuffer::STEAL, steal_offset, steal_end - steal_offset);
+  }
+  RETURN_IF_ERROR(scan_node_->AddDiskIoRanges(ranges));
+  return Status::OK;
+}
+
+void HdfsLzoTextScanner::CompleteSplits(int num_splits,
+    DiskIoMgr::ScanRange* extra_range) {
+  {
+    lock_guard<mutex> l(header_->lock);
+    if (extra_range != NULL) header_->extra_ranges.erase(extra_range);
+    header_->deferred_splits += num_splits;
+    if (!header_->extra_ranges.empty()) return;
+    num_splits = header_->deferred_splits;
+    header_->deferred_splits = 0;
+  }
+  for (int i = 0; i < num_splits; ++i) {
+    scan_node_->RangeComplete(THdfsFileFormat::LZO_TEXT, THdfsCompression::NONE);
+  }
+}
+
 Status HdfsLzoTextScanner::IssueInitialRanges(HdfsScanNode* scan_node,
     const vector<HdfsFileDesc*>& files) {
+  // Checked here so that all LZO files fail the same way, not only indexed ones.
+  if (FLAGS_lzo_sample_percent <= 0 || FLAGS_lzo_sample_percent > 100) {
+    stringstream ss;
+    ss << "Invalid --lzo_sample_percent: " << FLAGS_lzo_sample_percent
+       << ". It must be between 1 and 100.";
+    return Status(ss.str());
+  }
+
   vector<DiskIoMgr::ScanRange*> header_ranges;
   // Issue just the header range for each file.  When the header is complete,
   // we'll issue the ranges for that file.  Read the minimum header size plus
@@ -158,12 +385,166 @@ Status HdfsLzoTextScanner::IssueFileRanges(const char* filename) {
       ranges.push_back(range);
     }
     scan_node_->AddDiskIoRanges(ranges);
+  } else if (FLAGS_lzo_sample_percent != 100) {
+    RETURN_IF_ERROR(IssueSampledRanges(file_desc));
+  } else if (header_->incremental) {
+    RETURN_IF_ERROR(IssueIncrementalRanges(file_desc));
   } else {
     scan_node_->AddDiskIoRanges(file_desc);
   }
   return Status::OK;
 }
 
+Status HdfsLzoTextScanner::IssueSampledRanges(HdfsFileDesc* file_desc) {
+  int percent = FLAGS_lzo_sample_percent;
+  const vector<int64_t>& offsets = header_->offsets;
+  const string& filename = file_desc->filename;
+  ScanRangeMetadata* metadata =
+      reinterpret_cast<ScanRangeMetadata*>(file_desc->splits[0]->meta_data());
+  // Blocks are picked from the seed, the file name and the block number only, so
+  // the sample does not depend on how the file is split.
+  uint32_t file_seed =
+      HashUtil::Hash(filename.data(), filename.size(), FLAGS_lzo_sample_seed);
+
+  header_->sampled = true;
+  const vector<DiskIoMgr::ScanRange*>& splits = file_desc->splits;
+  vector<DiskIoMgr::ScanRange*> ranges;
+  int num_blocks = 0;
+  // The other splits of the file may be scanned by other impalads, only sample the
+  // blocks that start in the splits of this one.
+  {
+    lock_guard<mutex> l(header_->lock);
+    for (int j = 0; j < splits.size(); ++j) {
+      int first = lower_bound(offsets.begin(), offsets.end(), splits[j]->offset())
+          - offsets.begin();
+      int last = lower_bound(offsets.begin(), offsets.end(),
+          splits[j]->offset() + splits[j]->len()) - offsets.begin();
+      num_blocks += last - first;
+      for (int i = first; i < last; ++i) {
+        bool sample;
+        if (FLAGS_lzo_sample_systematic) {
+          // Add percent per block and sample a block each time the sum passes a
+          // multiple of 100. This samples exactly percent of every 100 blocks, evenly
+          // spaced, also when percent does not divide 100.
+          sample = (static_cast<int64_t>(i) * percent + file_seed % 100) % 100 < percent;
+        } else {
+          uint32_t hash = HashUtil::Hash(&i, sizeof(i), file_seed);
+          sample = hash % 100 < percent;
+        }
+        if (!sample) continue;
+        int64_t end = i + 1 < offsets.size() ? offsets[i + 1] : file_desc->file_length;
+        ranges.push_back(scan_node_->AllocateScanRange(filename.c_str(),
+            end - offsets[i], offsets[i], metadata->partition_id, -1));
+        header_->extra_ranges.insert(ranges.back());
+      }
+    }
+  }
+
+  COUNTER_UPDATE(ADD_COUNTER(scan_node_->runtime_profile(), "LzoBlocksSampled",
+      TCounterType::UNIT), ranges.size());
+  COUNTER_UPDATE(ADD_COUNTER(scan_node_->runtime_profile(), "LzoBlocksTotal",
+      TCounterType::UNIT), num_blocks);
+  VLOG_FILE << "Sampled " << ranges.size() << " of " << num_blocks
+            << " blocks of: " << filename;
+  RETURN_IF_ERROR(scan_node_->AddDiskIoRanges(ranges));
+  // The sampled blocks replace the initial splits. Those are reported complete once
+  // the sampled ranges are closed.
+  CompleteSplits(splits.size(), NULL);
+  return Status::OK;
+}
+
+Status HdfsLzoTextScanner::IssueIncrementalRanges(HdfsFileDesc* file_desc) {
+  const vector<DiskIoMgr::ScanRange*>& splits = file_desc->splits;
+  ScanRangeMetadata* metadata =
+      reinterpret_cast<ScanRangeMetadata*>(splits[0]->meta_data());
+  // Each split is replaced by at most one range, which reports it complete.
+  vector<DiskIoMgr::ScanRange*> ranges;
+  int num_scanned = 0;
+  for (int j = 0; j < splits.size(); ++j) {
+    int64_t cursor = SplitCursor(splits[j]);
+    if (cursor == -1) {
+      ranges.push_back(splits[j]);
+    } else if (cursor == LzoIndexCache::SPLIT_SCANNED) {
+      ++num_scanned;
+    } else {
+      int64_t end = splits[j]->offset() + splits[j]->len();
+      ranges.push_back(scan_node_->AllocateScanRange(file_desc->filename.c_str(),
+          end - cursor, cursor, metadata->partition_id, -1));
+    }
+  }
+  VLOG_FILE << "Incremental scan of: " << file_desc->filename << " skips "
+            << num_scanned << " of " << splits.size() << " splits";
+  RETURN_IF_ERROR(scan_node_->AddDiskIoRanges(ranges));
+  CompleteSplits(num_scanned, NULL);
+  return Status::OK;
+}
+
+const DiskIoMgr::ScanRange* HdfsLzoTextScanner::GetSplit() {
+  HdfsFileDesc* file_desc = scan_node_->GetFileDesc(stream_->filename());
+  int64_t offset = stream_->scan_range()->offset();
+  for (int j = 0; j < file_desc->splits.size(); ++j) {
+    const DiskIoMgr::ScanRange* split = file_desc->splits[j];
+    if (offset >= split->offset() && offset < split->offset() + split->len()) {
+      return split;
+    }
+  }
+  return NULL;
+}
+
+int64_t HdfsLzoTextScanner::SplitCursor(const DiskIoMgr::ScanRange* split) {
+  if (split == NULL) return -1;
+  map<int64_t, int64_t>::const_iterator it = header_->cursors.find(split->offset());
+  return it == header_->cursors.end() ? -1 : it->second;
+}
+
+void HdfsLzoTextScanner::AdvanceCursor() {
+  // The rows a scan did not return are left for the next one.
+  if (scan_node_->ReachedLimit() || context_->cancelled()) return;
+  const DiskIoMgr::ScanRange* split = GetSplit();
+  if (split == NULL) return;
+  // The split that holds the last block has returned the records up to the last
+  // delimiter of that block, the others all records that start in them.
+  int64_t last_block = header_->offsets.back();
+  bool has_last_block = last_block >= split->offset() &&
+      last_block < split->offset() + split->len();
+  if (has_last_block && !last_block_read_) return;
+  int64_t cursor = has_last_block ? last_block : LzoIndexCache::SPLIT_SCANNED;
+  LzoIndexCache::GetInstance(state_->exec_env()->mem_limit())->AdvanceCursor(
+      stream_->filename(), split->offset(), cursor);
+}
+
+void HdfsLzoTextScanner::SkipToCursor() {
+  skip_to_cursor_ = false;
+  if (bytes_remaining_ == 0) return;
+  char delim = context_->partition_descriptor()->line_delim();
+  uint8_t* last_delim = reinterpret_cast<uint8_t*>(
+      memrchr(block_buffer_ptr_, delim, bytes_remaining_));
+  // Without a delimiter the whole block is part of the first record, keep its last
+  // byte so the text scanner skips the rest of the record in the next blocks.
+  uint8_t* start = last_delim == NULL ?
+      block_buffer_ptr_ + bytes_remaining_ - 1 : last_delim;
+  bytes_remaining_ -= start - block_buffer_ptr_;
+  block_buffer_ptr_ = start;
+}
+
+void HdfsLzoTextScanner::TrimLastBlock() {
+  last_block_read_ = true;
+  eos_read_ = true;
+  char delim = context_->partition_descriptor()->line_delim();
+  uint8_t* last_delim = reinterpret_cast<uint8_t*>(
+      memrchr(block_buffer_ptr_, delim, bytes_remaining_));
+  bytes_remaining_ = last_delim == NULL ? 0 : last_delim - block_buffer_ptr_ + 1;
+}
+
+void HdfsLzoTextScanner::TrimSampledBlock(int64_t block_offset) {
+  // The last block of the file ends with a complete record.
+  if (bytes_remaining_ == 0 || block_offset == header_->offsets.back()) return;
+  char delim = context_->partition_descriptor()->line_delim();
+  uint8_t* last_delim = reinterpret_cast<uint8_t*>(
+      memrchr(block_buffer_ptr_, delim, bytes_remaining_));
+  bytes_remaining_ = last_delim == NULL ? 0 : last_delim - block_buffer_ptr_ + 1;
+}
+
 Status HdfsLzoTextScanner::ReadIndexFile() {
   string index_filename(stream_->filename());
   index_filename.append(INDEX_SUFFIX);
@@ -175,8 +556,10 @@ Status HdfsLzoTextScanner::ReadIndexFile() {
   if (hdfsExists(connection, index_filename.c_str()) != 0) {
     LOG(WARNING) << "No index file for: " << stream_->filename()
                  << ". Split scans are not possible.";
+    metrics_->SetUnindexed(stream_->filename(), true);
     return Status::OK;
   }
+  metrics_->SetUnindexed(stream_->filename(), false);
 
   hdfsFile index_file = hdfsOpenFile(connection,
        index_filename.c_str(), O_RDONLY, 0, 0, 0);
@@ -220,13 +603,177 @@ Status HdfsLzoTextScanner::ReadIndexFile() {
   return Status::OK;
 }
 
-Status HdfsLzoTextScanner::FindFirstBlock() {
+// Read len bytes at offset into buffer. Returns false on errors or if the file is
+// shorter.
+static bool ReadFully(hdfsFS connection, hdfsFile file, int64_t offset,
+    uint8_t* buffer, int len) {
+  while (len > 0) {
+    int num_read = hdfsPread(connection, file, offset, buffer, len);
+    if (num_read <= 0) return false;
+    offset += num_read;
+    buffer += num_read;
+    len -= num_read;
+  }
+  return true;
+}
+
+// Parse the uncompressed and compressed sizes at the start of the block header in
+// buffer, for the block at 'offset', and set *end to the offset just past the block.
+// Returns false if there is no complete block at 'offset', e.g. because it is
+// still being written.
+static bool ParseBlockEnd(const uint8_t* buffer, int64_t offset, int64_t file_length,
+    bool output_checksum, bool input_checksum, int64_t* end) {
+  int32_t uncompressed_len = ReadWriteUtil::GetInt<uint32_t>(buffer);
+  int32_t compressed_len = ReadWriteUtil::GetInt<uint32_t>(buffer + sizeof(int32_t));
+  // A zero length marks the end of the compressed data.
+  if (uncompressed_len <= 0 || compressed_len <= 0) return false;
+  if (compressed_len > LZO_MAX_BLOCK_SIZE) return false;
+  int header_len = 2 * sizeof(int32_t);
+  if (output_checksum) header_len += sizeof(int32_t);
+  if (input_checksum && compressed_len < uncompressed_len) header_len += sizeof(int32_t);
+  *end = offset + header_len + compressed_len;
+  return *end <= file_length;
+}
+
+// Read the header of the block at 'offset' and set *end to the offset just past it.
+// Returns false if there is no complete block at 'offset'.
+static bool ReadBlockEnd(hdfsFS connection, hdfsFile file, int64_t offset,
+    int64_t file_length, bool output_checksum, bool input_checksum, int64_t* end) {
+  uint8_t buffer[2 * sizeof(int32_t)];
+  if (file_length - offset < sizeof(buffer)) return false;
+  if (!ReadFully(connection, file, offset, buffer, sizeof(buffer))) return false;
+  return ParseBlockEnd(buffer, offset, file_length, output_checksum, input_checksum,
+      end);
+}
+
+// Walk the headers of the blocks from *tail to the end of the file, append their
+// offsets and set *tail to the end of the last complete block. The file is read
+// into buffer, buffer_len bytes at a time, and the headers are parsed from there.
+// Returns the number of blocks found.
+static int WalkBlocks(hdfsFS connection, hdfsFile file, int64_t file_length,
+    bool output_checksum, bool input_checksum, uint8_t* buffer, int buffer_len,
+    int64_t* tail, vector<int64_t>* offsets) {
+  const int block_sizes_len = 2 * sizeof(int32_t);
+  int num_blocks = 0;
+  // File range held by buffer.
+  int64_t buffer_start = 0;
+  int64_t buffer_end = 0;
+  while (file_length - *tail >= block_sizes_len) {
+    if (*tail + block_sizes_len > buffer_end || *tail < buffer_start) {
+      int len = min<int64_t>(buffer_len, file_length - *tail);
+      if (!ReadFully(connection, file, *tail, buffer, len)) break;
+      buffer_start = *tail;
+      buffer_end = *tail + len;
+    }
+    int64_t end;
+    if (!ParseBlockEnd(buffer + (*tail - buffer_start), *tail, file_length,
+        output_checksum, input_checksum, &end)) {
+      break;
+    }
+    offsets->push_back(*tail);
+    *tail = end;
+    ++num_blocks;
+  }
+  return num_blocks;
+}
+
+Status HdfsLzoTextScanner::ReadBlockOffsets() {
+  const char* filename = stream_->filename();
+  int64_t file_length = scan_node_->GetFileDesc(filename)->file_length;
+  LzoIndexCache* cache = LzoIndexCache::GetInstance(state_->exec_env()->mem_limit());
+  LzoIndexCache::Entry entry;
+  bool cached = cache->Lookup(filename, &entry) && entry.file_length <= file_length;
+  if (!cached) {
+    entry = LzoIndexCache::Entry();
+    RETURN_IF_ERROR(ReadIndexFile());
+    // Without an index there is nothing to extend: the file is read sequentially.
+    // Only files with an index count as cache lookups.
+    if (header_->offsets.empty()) return Status::OK;
+    metrics_->index_cache_misses->Increment(1L);
+  }
+
+  hdfsFS connection = scan_node_->hdfs_connection();
+  hdfsFile file = hdfsOpenFile(connection, filename, O_RDONLY, 0, 0, 0);
+  if (file == NULL) {
+    stringstream ss;
+    ss << AppendHdfsErrorMessage("Error while opening file: ", filename);
+    if (state_->LogHasSpace()) state_->LogError(ss.str());
+    return Status(ss.str());
+  }
+  bool output_checksum = header_->output_checksum_type_ != CHECK_NONE;
+  bool input_checksum = header_->input_checksum_type_ != CHECK_NONE;
+
+  if (cached) {
+    // The file may have been rewritten rather than appended to. Make sure the last
+    // cached block is still where it was.
+    int64_t end;
+    if (!entry.offsets.empty() &&
+        ReadBlockEnd(connection, file, entry.offsets.back(), file_length,
+            output_checksum, input_checksum, &end) && end == entry.tail) {
+      header_->offsets.swap(entry.offsets);
+      metrics_->index_cache_hits->Increment(1L);
+    } else {
+      VLOG_FILE << "Dropping stale cached block offsets for: " << filename;
+      cache->Remove(filename);
+      cached = false;
+      entry.cursors.clear();
+      Status status = ReadIndexFile();
+      if (!status.ok() || header_->offsets.empty()) {
+        hdfsCloseFile(connection, file);
+        return status;
+      }
+      metrics_->index_cache_misses->Increment(1L);
+    }
+  }
+
+  if (!cached) {
+    entry.tail = header_->offsets.back();
+    if (!ReadBlockEnd(connection, file, entry.tail, file_length,
+        output_checksum, input_checksum, &entry.tail)) {
+      // The index points past the data, leave the offsets as they are.
+      hdfsCloseFile(connection, file);
+      LOG(WARNING) << "Index file for: " << filename << " does not match the file.";
+      return Status::OK;
+    }
+  }
+
+  // Walk the headers of the blocks appended after the last known one.
+  int num_appended = 0;
+  if (entry.tail < file_length) {
+    MemPool pool(state_->mem_limits());
+    int buffer_len = min<int64_t>(APPENDED_BLOCKS_READ_SIZE, file_length - entry.tail);
+    uint8_t* buffer = pool.Allocate(buffer_len);
+    num_appended = WalkBlocks(connection, file, file_length, output_checksum,
+        input_checksum, buffer, buffer_len, &entry.tail, &header_->offsets);
+  }
+  hdfsCloseFile(connection, file);
+  if (num_appended > 0) {
+    VLOG_FILE << "Found " << num_appended << " blocks past the "
+              << (cached ? "cached offsets" : "index") << " of: " << filename;
+  }
+
+  // Sampling takes precedence over incremental scans.
+  if (FLAGS_lzo_incremental_scan && FLAGS_lzo_sample_percent == 100) {
+    // The cursors only move when the scanners of the splits complete.
+    header_->incremental = true;
+    header_->cursors = entry.cursors;
+  }
+  entry.file_length = file_length;
+  entry.offsets = header_->offsets;
+  cache->Update(filename, entry);
+  return Status::OK;
+}
+
+Status HdfsLzoTextScanner::FindFirstBlock(bool skip_block_at_offset) {
   int64_t offset = stream_->file_offset();
 
   // Find the first block at or after the current file offset.  That way the
-  // scan will start, or restart, on a block boundary.
-  vector<int64_t>::iterator pos =
-      upper_bound(header_->offsets.begin(), header_->offsets.end(), offset);
+  // scan will start, or restart, on a block boundary.  A split that starts exactly
+  // on a block starts with that block: the previous split only reads it up to the
+  // end of its last record.
+  vector<int64_t>::iterator pos = skip_block_at_offset ?
+      upper_bound(header_->offsets.begin(), header_->offsets.end(), offset) :
+      lower_bound(header_->offsets.begin(), header_->offsets.end(), offset);
 
   if (pos == header_->offsets.end()) {
     stringstream ss;
@@ -244,12 +791,34 @@ Status HdfsLzoTextScanner::FindFirstBlock() {
 
 Status HdfsLzoTextScanner::ReadData() {
   do {
+    int64_t block_offset = stream_->file_offset();
     Status status = ReadAndDecompressData();
+    if (status.ok() && bytes_remaining_ > 0) scan_stats_.AddBlock(bytes_remaining_);
+    if (status.ok() && header_->sampled) TrimSampledBlock(block_offset);
+    if (status.ok() && skip_to_cursor_) SkipToCursor();
+    if (status.ok() && header_->incremental && block_offset == header_->offsets.back()) {
+      TrimLastBlock();
+    }
+    if (status.ok() && prefilter_ != NULL && bytes_remaining_ > 0) {
+      int64_t trace_start = TraceStart();
+      int kept = prefilter_->Filter(block_buffer_ptr_, bytes_remaining_);
+      COUNTER_UPDATE(prefilter_bytes_counter_, bytes_remaining_ - kept);
+      if (trace_ != NULL) {
+        trace_->AddEvent(LzoTraceBuffer::PREFILTER, trace_start, block_offset,
+            bytes_remaining_ - kept);
+      }
+      bytes_remaining_ = kept;
+    }
 
     if (status.ok() || state_->abort_on_error()) return status;
 
     // On error try to skip forward to the next block.
-    status = FindFirstBlock();
+    ++scan_stats_.recovered_errors;
+    skip_to_cursor_ = false;
+    if (trace_ != NULL) {
+      trace_->AddInstant(LzoTraceBuffer::ERROR_SKIP, stream_->file_offset(), 0);
+    }
+    status = FindFirstBlock(true);
     if (!status.ok()) {
       if (state_->abort_on_error()) return status;
 
@@ -259,7 +828,7 @@ Status HdfsLzoTextScanner::ReadData() {
       bytes_remaining_ = 0;
       return Status::OK;
     }
-  } while (!stream_->eosr());
+  } while (!AtRangeEnd());
 
   // Reset the scanner state.
   HdfsTextScanner::ResetScanner();
@@ -275,44 +844,48 @@ Status HdfsLzoTextScanner::FillByteBuffer(bool* eosr, int num_bytes) {
     return Status::OK;
   }
 
-  if (stream_->eosr()) {
+  // Sampled blocks are scanned on their own, never past the end of the block, and
+  // incremental scans stop at their last block.
+  if (((header_->sampled && eos_read_) || last_block_read_) && bytes_remaining_ == 0) {
+    *eosr = true;
+    return Status::OK;
+  }
+
+  if (AtRangeEnd()) {
+    // The text scanner only reads past eosr for the rest of its last record, with a
+    // size. If blocks were stolen after the last block of the range was returned,
+    // eosr was not set with it, so set it now instead of returning the next block
+    // as part of the range.
+    if (!past_eosr_ && num_bytes == 0 && bytes_remaining_ == 0) {
+      *eosr = true;
+      return Status::OK;
+    }
     // Set the read size to be the biggest a block could be. This needs
     // to be done here because the text scanner will set it to something
     // smaller during initialization.
     stream_->set_read_past_buffer_size(MAX_BLOCK_COMPRESSED_SIZE);
+    if (!past_eosr_) {
+      // The next block is the first block of the adjacent range.
+      end_boundary_ = EndBoundary();
+      past_eosr_offset_ = stream_->file_offset();
+      if (trace_ != NULL) {
+        trace_->AddInstant(LzoTraceBuffer::READ_PAST_EOSR, stream_->file_offset(), 0);
+      }
+    }
     past_eosr_ = true;
     VLOG_ROW << "Reading past eosr: " << stream_->filename()
              << " @" << stream_->file_offset();
   }
 
-  // Figure out if we have enough data and read more if necessary.
-  if ((num_bytes == 0 && bytes_remaining_ == 0) || num_bytes > bytes_remaining_) {
-    // Read and decompress the next block.
-    RETURN_IF_ERROR(ReadData());
-  }
+  // Read and decompress the next block once this one is used up. A request for more
+  // bytes than are left, e.g. the text scanner's reads past eosr, gets the rest of
+  // the block: reading the next block here would drop those bytes.
+  if (bytes_remaining_ == 0) RETURN_IF_ERROR(ReadData());
 
   if (bytes_remaining_ != 0) {
-    if (bytes_remaining_ >= num_bytes) {
-      // We have enough bytes left to fill the request.
-      byte_buffer_ptr_ = reinterpret_cast<char*>(block_buffer_ptr_);
-      if (num_bytes == 0) {
-         byte_buffer_read_size_ = bytes_remaining_;
-      } else {
-         byte_buffer_read_size_ = num_bytes;
-      }
-    } else {
-      byte_buffer_ptr_ = reinterpret_cast<char*>(block_buffer_ptr_);
-      byte_buffer_read_size_ = num_bytes;
-    }
-    // We assume a block is larger than the largest request.
-    if (!eos_read_ && num_bytes > bytes_remaining_) {
-      // Text only reads everything or 1024 so we do not need to handle this case.
-      if (state_->LogHasSpace()) {
-        state_->LogError("Unexpected read size in LZO decompressor");
-      }
-      DCHECK_LE(num_bytes, bytes_remaining_);
-      return Status("Unexpected read size in LZO decompressor");
-    }
+    byte_buffer_ptr_ = reinterpret_cast<char*>(block_buffer_ptr_);
+    byte_buffer_read_size_ =
+        num_bytes == 0 ? bytes_remaining_ : min(num_bytes, bytes_remaining_);
   }
 
   byte_buffer_end_ = byte_buffer_ptr_ + byte_buffer_read_size_;
@@ -323,6 +896,11 @@ Status HdfsLzoTextScanner::FillByteBuffer(bool* eosr, int num_bytes) {
 
   *eosr = past_eosr_ || (eos_read_ && bytes_remaining_ == 0);
 
+  if (trace_ != NULL && byte_buffer_read_size_ != 0) {
+    trace_->AddInstant(LzoTraceBuffer::HANDOFF, stream_->file_offset(),
+        byte_buffer_read_size_);
+  }
+
   if (VLOG_ROW_IS_ON && *eosr) {
     VLOG_ROW << "Returning eosr for: " << stream_->filename()
              << " @" << stream_->file_offset();
@@ -330,28 +908,13 @@ Status HdfsLzoTextScanner::FillByteBuffer(bool* eosr, int num_bytes) {
   return Status::OK;
 }
 
-Status HdfsLzoTextScanner::Checksum(LzoChecksum type, const string& source,
-    int expected_checksum, uint8_t* buffer, int length) {
-
-  if (disable_checksum_) return Status::OK;
-
-  // Do the checksum if requested.
-  int32_t calculated_checksum;
-  switch (type) {
-    case CHECK_NONE:
-      return Status::OK;
-
-    case CHECK_CRC32:
-      calculated_checksum = lzo_crc32(CRC32_INIT_VALUE, buffer, length);
-      break;
-
-    case CHECK_ADLER:
-      calculated_checksum = lzo_adler32(ADLER32_INIT_VALUE, buffer, length);
-      break;
-
-    default:
-      DCHECK(false);
-  }
+template <HdfsLzoTextScanner::LzoChecksum TYPE>
+Status HdfsLzoTextScanner::Checksum(const char* source, int expected_checksum,
+    uint8_t* buffer, int length) {
+  DCHECK_NE(TYPE, CHECK_NONE);
+  int32_t calculated_checksum = (TYPE == CHECK_CRC32) ?
+      lzo_crc32(CRC32_INIT_VALUE, buffer, length) :
+      lzo_adler32(ADLER32_INIT_VALUE, buffer, length);
 
   if (calculated_checksum != expected_checksum) {
     stringstream ss;
@@ -486,27 +1049,68 @@ Status HdfsLzoTextScanner::ReadHeader() {
   }
 
   header_->header_size_ = h_ptr - magic;
+  header_->read_block_fn_ = SelectBlockReader(
+      header_->input_checksum_type_, header_->output_checksum_type_);
 
   return Status::OK;
 }
 
-Status HdfsLzoTextScanner::ReadAndDecompressData() {
+HdfsLzoTextScanner::ReadBlockFn HdfsLzoTextScanner::SelectBlockReader(
+    LzoChecksum input, LzoChecksum output) {
+#define LZO_BLOCK_READERS(INPUT, VERIFY) { \
+    &HdfsLzoTextScanner::ReadAndDecompressBlock<INPUT, CHECK_NONE, VERIFY>, \
+    &HdfsLzoTextScanner::ReadAndDecompressBlock<INPUT, CHECK_CRC32, VERIFY>, \
+    &HdfsLzoTextScanner::ReadAndDecompressBlock<INPUT, CHECK_ADLER, VERIFY> }
+  // Indexed by [verify][input][output].
+  static const ReadBlockFn READERS[2][3][3] = {
+    { LZO_BLOCK_READERS(CHECK_NONE, false),
+      LZO_BLOCK_READERS(CHECK_CRC32, false),
+      LZO_BLOCK_READERS(CHECK_ADLER, false) },
+    { LZO_BLOCK_READERS(CHECK_NONE, true),
+      LZO_BLOCK_READERS(CHECK_CRC32, true),
+      LZO_BLOCK_READERS(CHECK_ADLER, true) },
+  };
+#undef LZO_BLOCK_READERS
+  return READERS[!disable_checksum_][input][output];
+}
+
+template <HdfsLzoTextScanner::LzoChecksum INPUT,
+    HdfsLzoTextScanner::LzoChecksum OUTPUT, bool VERIFY>
+Status HdfsLzoTextScanner::ReadAndDecompressBlock() {
   bytes_remaining_ = 0;
   Status status;
-  
-  // Read the uncompressed
-  int32_t uncompressed_len = 0, compressed_len = 0;
-  stream_->ReadInt(&uncompressed_len, &status);
+  int64_t block_offset = stream_->file_offset();
+  int64_t trace_start = TraceStart();
+
+  // Read the uncompressed and compressed lengths and the checksum of the
+  // uncompressed data with one access.
+  const int header_len =
+      2 * sizeof(int32_t) + (OUTPUT != CHECK_NONE ? sizeof(int32_t) : 0);
+  uint8_t* block_header;
+  int bytes_read;
+  bool eos;
+  stream_->GetBytes(header_len, &block_header, &bytes_read, &eos, &status);
   RETURN_IF_ERROR(status);
-  if (uncompressed_len == 0) {
+
+  // A zero uncompressed length marks the end of the compressed data.
+  if (bytes_read >= sizeof(int32_t) &&
+      ReadWriteUtil::GetInt<uint32_t>(block_header) == 0) {
     DCHECK(stream_->eosr());
     eos_read_ = true;
     return Status::OK;
   }
-
-  // Read the compressed len
-  stream_->ReadInt(&compressed_len, &status);
-  RETURN_IF_ERROR(status);
+  if (bytes_read < header_len) {
+    stringstream ss;
+    ss << "Truncated block header on file: " << stream_->filename()
+       << " at offset: " << block_offset;
+    if (state_->LogHasSpace()) state_->LogError(ss.str());
+    return Status(ss.str());
+  }
+  int32_t uncompressed_len = ReadWriteUtil::GetInt<uint32_t>(block_header);
+  int32_t compressed_len =
+      ReadWriteUtil::GetInt<uint32_t>(block_header + sizeof(int32_t));
+  int32_t out_checksum = (OUTPUT == CHECK_NONE) ? 0 :
+      ReadWriteUtil::GetInt<uint32_t>(block_header + 2 * sizeof(int32_t));
 
   if (compressed_len > LZO_MAX_BLOCK_SIZE) {
     stringstream ss;
@@ -516,58 +1120,68 @@ Status HdfsLzoTextScanner::ReadAndDecompressData() {
     return Status(ss.str());
   }
 
-  int out_checksum;
-  // The checksum of the uncompressed data.
-  if (header_->output_checksum_type_ != CHECK_NONE) {
-    stream_->ReadInt(&out_checksum, &status);
-    RETURN_IF_ERROR(status);
+  // Only compressed blocks are worth sharing with the adjacent range. A stored block
+  // at a boundary is passed when the scanner is closed.
+  int64_t* boundary = NULL;
+  if (block_offset == start_boundary_) boundary = &start_boundary_;
+  if (block_offset == end_boundary_) boundary = &end_boundary_;
+
+  // If the compressed length is the same as the uncompressed length, it means the data
+  // was not compressed and there is no compressed checksum.
+  if (compressed_len == uncompressed_len) {
+    return ReadStoredBlock<OUTPUT, VERIFY>(block_offset, trace_start,
+        uncompressed_len, out_checksum);
   }
-  
-  int in_checksum = 0;
-  if (compressed_len < uncompressed_len && header_->input_checksum_type_ != CHECK_NONE) {
+
+  // The checksum of the compressed data is only present for compressed blocks.
+  int32_t in_checksum = 0;
+  if (INPUT != CHECK_NONE) {
     stream_->ReadInt(&in_checksum, &status);
     RETURN_IF_ERROR(status);
-  } else {
-    // If the compressed data size is equal to the uncompressed data size, then
-    // the uncompressed data is stored and there is no compressed checksum.
-    in_checksum = out_checksum;
+  }
+
+  if (boundary != NULL) {
+    bool taken;
+    RETURN_IF_ERROR(
+        TakeBoundaryBlock(boundary, uncompressed_len, compressed_len, &taken));
+    if (taken) return Status::OK;
   }
 
   // Read in the compressed data
   uint8_t* compressed_data;
-  int bytes_read;
   stream_->GetBytes(compressed_len, &compressed_data, &bytes_read, &eos_read_, &status);
   DCHECK_EQ(compressed_len, bytes_read);
   RETURN_IF_ERROR(status);
-
-  // Checksum the data.
-  RETURN_IF_ERROR(Checksum(header_->input_checksum_type_,
-      "compressed", in_checksum, compressed_data, compressed_len));
-
-  // If the compressed length is the same as the uncompressed length, it means the data
-  // was not compressed and we are done.
-  if (compressed_len == uncompressed_len) {
-    block_buffer_ptr_ = compressed_data;
-    bytes_remaining_ = uncompressed_len;
-    return Status::OK;
+  if (trace_ != NULL) {
+    trace_->AddEvent(LzoTraceBuffer::READ, trace_start, block_offset, compressed_len);
   }
 
-  if (!stream_->compact_data()) {
-    AttachPool(block_buffer_pool_.get());
-    block_buffer_len_ = 0;
+  // Checksum the data.
+  if (VERIFY && INPUT != CHECK_NONE) {
+    trace_start = TraceStart();
+    RETURN_IF_ERROR(Checksum<INPUT>(
+        "compressed", in_checksum, compressed_data, compressed_len));
+    if (trace_ != NULL) {
+      trace_->AddEvent(LzoTraceBuffer::CHECKSUM, trace_start, block_offset,
+          compressed_len);
+    }
   }
 
-  if (uncompressed_len > block_buffer_len_) {
-    block_buffer_ = block_buffer_pool_->Allocate(uncompressed_len);
-    block_buffer_len_ = uncompressed_len;
-  }
+  AllocateBlockBuffer(uncompressed_len);
   block_buffer_ptr_ = block_buffer_;
   bytes_remaining_ = uncompressed_len;
 
   // Decompress the data.  lzop always uses lzo1x.
   SCOPED_TIMER(decompress_timer_);
+  trace_start = TraceStart();
+  decompress_watch_.Start();
   int ret = lzo1x_decompress_safe(compressed_data, compressed_len,
       block_buffer_, reinterpret_cast<lzo_uint*>(&uncompressed_len), NULL);
+  decompress_watch_.Stop();
+  if (trace_ != NULL) {
+    trace_->AddEvent(LzoTraceBuffer::DECOMPRESS, trace_start, block_offset,
+        uncompressed_len);
+  }
 
   if (ret != LZO_E_OK || bytes_remaining_ != uncompressed_len) {
     stringstream ss;
@@ -578,19 +1192,204 @@ Status HdfsLzoTextScanner::ReadAndDecompressData() {
     if (state_->LogHasSpace()) state_->LogError(ss.str());
     return Status(ss.str());
   }
+  scan_stats_.decompressed_bytes += uncompressed_len;
 
   // Do the checksum if requested.
-  RETURN_IF_ERROR(Checksum(header_->output_checksum_type_,
-     "decompressed", out_checksum, block_buffer_, uncompressed_len));
+  if (VERIFY && OUTPUT != CHECK_NONE) {
+    trace_start = TraceStart();
+    RETURN_IF_ERROR(Checksum<OUTPUT>(
+        "decompressed", out_checksum, block_buffer_, uncompressed_len));
+    if (trace_ != NULL) {
+      trace_->AddEvent(LzoTraceBuffer::CHECKSUM, trace_start, block_offset,
+          uncompressed_len);
+    }
+  }
+
+  if (boundary != NULL && *boundary != -1) PublishBoundaryBlock(boundary);
 
   // Return end of scan range even if there are bytes in the disk buffer.
   // We fetched the next disk buffer past EOSR to complete the read of this compressed
   // block.  When the scanner finishes with the data we return here it must
   // go into Finish mode and complete its final row.
-  eos_read_ = stream_->eosr();
+  eos_read_ = AtRangeEnd();
   VLOG_ROW << "LZO decompressed " << uncompressed_len << " bytes from " 
            << stream_->filename() << " @" << stream_->file_offset() - compressed_len;
   return Status::OK;
 }
 
+template <HdfsLzoTextScanner::LzoChecksum OUTPUT, bool VERIFY>
+Status HdfsLzoTextScanner::ReadStoredBlock(int64_t block_offset, int64_t trace_start,
+    int32_t len, int32_t checksum) {
+  Status status;
+  uint8_t* data;
+  int bytes_read;
+  stream_->GetBytes(len, &data, &bytes_read, &eos_read_, &status);
+  DCHECK_EQ(len, bytes_read);
+  RETURN_IF_ERROR(status);
+  if (trace_ != NULL) {
+    trace_->AddEvent(LzoTraceBuffer::READ, trace_start, block_offset, len);
+  }
+
+  // The stored data is the uncompressed data, it has the uncompressed checksum.
+  if (VERIFY && OUTPUT != CHECK_NONE) {
+    trace_start = TraceStart();
+    RETURN_IF_ERROR(Checksum<OUTPUT>("stored", checksum, data, len));
+    if (trace_ != NULL) {
+      trace_->AddEvent(LzoTraceBuffer::CHECKSUM, trace_start, block_offset, len);
+    }
+  }
+
+  // The prefilter edits the block in place, data belongs to the stream.
+  if (prefilter_ != NULL) {
+    AllocateBlockBuffer(len);
+    memcpy(block_buffer_, data, len);
+    data = block_buffer_;
+  }
+  block_buffer_ptr_ = data;
+  bytes_remaining_ = len;
+  if (!eos_read_) eos_read_ = AtRangeEnd();
+  return Status::OK;
+}
+
+void HdfsLzoTextScanner::AllocateBlockBuffer(int32_t len) {
+  if (!stream_->compact_data()) {
+    AttachPool(block_buffer_pool_.get());
+    block_buffer_len_ = 0;
+  }
+
+  if (len > block_buffer_len_) {
+    block_buffer_ = block_buffer_pool_->Allocate(len);
+    block_buffer_len_ = len;
+  }
+}
+
+HdfsLzoTextScanner::LzoFileHeader::~LzoFileHeader() {
+  for (map<int64_t, BoundaryBlock>::iterator it = boundary_blocks.begin();
+       it != boundary_blocks.end(); ++it) {
+    if (it->second.pool == NULL) continue;
+    it->second.pool->FreeAll();
+    delete it->second.pool;
+  }
+}
+
+HdfsLzoTextScanner::BoundaryBudget* HdfsLzoTextScanner::GetBoundaryBudget() {
+  lock_guard<mutex> l(boundary_budget_lock);
+  BoundaryBudget* budget = reinterpret_cast<BoundaryBudget*>(
+      scan_node_->GetFileMetadata(BOUNDARY_BUDGET_KEY));
+  if (budget == NULL) {
+    budget = state_->obj_pool()->Add(new BoundaryBudget());
+    scan_node_->SetFileMetadata(BOUNDARY_BUDGET_KEY, budget);
+  }
+  return budget;
+}
+
+int64_t HdfsLzoTextScanner::EndBoundary() const {
+  if (!share_boundaries_) return -1;
+  const vector<int64_t>& offsets = header_->offsets;
+  int64_t end = EndBlock(active_range_.blocks);
+  return end < offsets.size() ? offsets[end] : -1;
+}
+
+Status HdfsLzoTextScanner::TakeBoundaryBlock(int64_t* boundary,
+    int32_t uncompressed_len, int32_t compressed_len, bool* taken) {
+  *taken = false;
+  int64_t block_offset = *boundary;
+  BoundaryBlock block;
+  {
+    lock_guard<mutex> l(header_->lock);
+    map<int64_t, BoundaryBlock>::iterator it =
+        header_->boundary_blocks.find(block_offset);
+    // The other scanner has not passed the block yet.
+    if (it == header_->boundary_blocks.end()) return Status::OK;
+    block = it->second;
+    header_->boundary_blocks.erase(it);
+  }
+  *boundary = -1;
+  if (block.pool == NULL || block.len != uncompressed_len) {
+    ReleaseBoundaryBlock(block);
+    return Status::OK;
+  }
+
+  int64_t trace_start = TraceStart();
+  Status status;
+  stream_->SkipBytes(compressed_len, &status);
+  if (status.ok()) {
+    AllocateBlockBuffer(uncompressed_len);
+    memcpy(block_buffer_, block.data, uncompressed_len);
+  }
+  ReleaseBoundaryBlock(block);
+  RETURN_IF_ERROR(status);
+  block_buffer_ptr_ = block_buffer_;
+  bytes_remaining_ = uncompressed_len;
+  eos_read_ = AtRangeEnd();
+  COUNTER_UPDATE(boundary_blocks_reused_counter_, 1);
+  if (trace_ != NULL) {
+    trace_->AddEvent(LzoTraceBuffer::BOUNDARY_REUSE, trace_start, block_offset,
+        uncompressed_len);
+  }
+  *taken = true;
+  return Status::OK;
+}
+
+void HdfsLzoTextScanner::PublishBoundaryBlock(int64_t* boundary) {
+  // Copy the block outside the lock if it fits in the scan node's budget.
+  BoundaryBlock block;
+  block.pool = NULL;
+  block.data = NULL;
+  block.len = bytes_remaining_;
+  int64_t* budget = &header_->boundary_budget->bytes;
+  if (__sync_add_and_fetch(budget, block.len) <= FLAGS_lzo_boundary_block_bytes) {
+    block.pool = new MemPool(state_->mem_limits());
+    block.data = block.pool->Allocate(block.len);
+    memcpy(block.data, block_buffer_ptr_, block.len);
+  } else {
+    __sync_fetch_and_sub(budget, block.len);
+  }
+
+  BoundaryBlock other;
+  {
+    lock_guard<mutex> l(header_->lock);
+    map<int64_t, BoundaryBlock>::iterator it = header_->boundary_blocks.find(*boundary);
+    if (it == header_->boundary_blocks.end()) {
+      header_->boundary_blocks[*boundary] = block;
+      *boundary = -1;
+      return;
+    }
+    // Both scanners decompressed the block at the same time, nobody needs it now.
+    other = it->second;
+    header_->boundary_blocks.erase(it);
+  }
+  *boundary = -1;
+  ReleaseBoundaryBlock(other);
+  ReleaseBoundaryBlock(block);
+}
+
+void HdfsLzoTextScanner::PassBoundary(int64_t* boundary) {
+  if (*boundary == -1) return;
+  BoundaryBlock block;
+  block.pool = NULL;
+  block.data = NULL;
+  block.len = 0;
+  {
+    lock_guard<mutex> l(header_->lock);
+    map<int64_t, BoundaryBlock>::iterator it = header_->boundary_blocks.find(*boundary);
+    if (it == header_->boundary_blocks.end()) {
+      // Tell the other scanner that it does not need to keep the block.
+      header_->boundary_blocks[*boundary] = block;
+    } else {
+      block = it->second;
+      header_->boundary_blocks.erase(it);
+    }
+  }
+  *boundary = -1;
+  ReleaseBoundaryBlock(block);
+}
+
+void HdfsLzoTextScanner::ReleaseBoundaryBlock(const BoundaryBlock& block) {
+  if (block.pool == NULL) return;
+  __sync_fetch_and_sub(&header_->boundary_budget->bytes, block.len);
+  block.pool->FreeAll();
+  delete block.pool;
+}
+
 }
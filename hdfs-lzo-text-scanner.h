@@ -4,10 +4,19 @@
 #define IMPALA_LZO_TEXT_SCANNER_H
 
 #include "lzo-header.h"
+#include "lzo-index-cache.h"
+#include "lzo-metrics.h"
+#include "lzo-prefilter.h"
+#include "lzo-trace.h"
+#include <list>
+#include <map>
+#include <set>
 #include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
 #include "common/version.h"
 #include "exec/hdfs-text-scanner.h"
 #include "runtime/string-buffer.h"
+#include "util/stopwatch.h"
 
 // This provides support for reading files compressed with lzop.
 // The file consists of a header and compressed blocks preceeded
@@ -66,6 +75,55 @@ class HdfsLzoTextScanner;
 // find the next block.
 // If there is no index file then the file is non-splittble. A single scan range
 // will be issued for the whole file and no error recovery is done.
+//
+// LZO files are often appended to after they have been indexed. Blocks past the
+// last indexed block are found by walking the block headers from there, and the
+// resulting offsets are kept in the process-wide LzoIndexCache. A later query on
+// the same file reuses them and only walks the blocks appended since.
+//
+// With --lzo_incremental_scan, the LzoIndexCache entry of a file also keeps a cursor
+// per split this impalad has scanned. When the range of a split has been scanned to
+// the end, its cursor moves to the last block of the file if that block is in the
+// split, and past the split otherwise. The next scan of the split starts at the
+// cursor, skips the records of the block that were already returned and stops
+// after the last block found by its header scan. The partial last record of that
+// block is left for the next scan, which reads it once it has been completed by
+// the appended blocks. A scan that is cancelled or stops at a limit does not move
+// the cursors. A split without a cursor, for example after the entry has been
+// evicted, is read in full. Incremental ranges are not stolen from, since a split
+// must be scanned by one range. A record that is longer than a block and still
+// being written when the file is scanned is returned truncated.
+//
+// For approximate queries, --lzo_sample_percent makes the scanners of indexed files
+// read only a reproducible subset of the blocks. Each sampled block is its own scan
+// range, and its partial first and last records are dropped. The
+// LzoBlocksSampled / LzoBlocksTotal counters give the fraction to scale results by.
+//
+// With --lzo_prefilter, when the scan has LIKE or string equality conjuncts, each
+// decompressed block is first searched for the literals they require (see
+// LzoBlockPrefilter). Records that cannot match are removed before the text parser
+// sees the block.
+//
+// With an index, a scanner that finishes its range steals the second half of the
+// not yet started blocks of the busiest range of the same file
+// (see --lzo_steal_min_blocks). The victim stops at the first stolen block, reading
+// past it to finish its last record exactly as it does at the end of a scan range,
+// and a new scan range starting at that block is issued for the rest. The splits
+// of the file are not reported complete to the scan node while stolen ranges are
+// still open, so the scan does not end before their rows are returned.
+//
+// The block just past the end of a range is decompressed by two scanners: the one
+// finishing its last record and the one starting the next range. Whichever gets
+// there first keeps a copy of the decompressed block in the file header, and the
+// other one copies it instead of decompressing the block again. The copies are
+// charged to the query's memory limits, the bytes a scan node keeps are bounded by
+// --lzo_boundary_block_bytes, and a copy is dropped as soon as both scanners have
+// passed its block, whether they read it or not.
+//
+// If --lzo_trace_dir is set, each scanner records a timeline of per-block events
+// (reads, decompression, checksums, handoffs to the parser, reads past the end of
+// the scan range and error skips) and appends it to a Chrome trace-event file
+// per fragment in that directory.
 
 
 // Used to verify that this library was built against the expected Impala version when the
@@ -126,6 +184,47 @@ class HdfsLzoTextScanner : public HdfsTextScanner {
   // and an option seciton.
   const static int HEADER_SIZE = 300;
 
+  // Size of the reads used to find the blocks appended after the last known block.
+  const static int APPENDED_BLOCKS_READ_SIZE = 8 * 1024 * 1024;
+
+  // File metadata key of the scan node's BoundaryBudget. File names are absolute
+  // paths, so it cannot collide with one.
+  const static std::string BOUNDARY_BUDGET_KEY;
+
+  // Reads and decompresses the next block. See ReadAndDecompressBlock().
+  typedef Status (HdfsLzoTextScanner::*ReadBlockFn)();
+
+  // A scan range in progress whose remaining blocks may be stolen.
+  struct ActiveRange {
+    // Index in offsets of the block the scanner is reading in the upper 32 bits, and
+    // of the first block past the end of the range in the lower 32 bits. Both are
+    // updated together with compare-and-swap: the scanner only moves the first one
+    // forward and a stealer only lowers the second one, so the scanner never starts
+    // a stolen block. See PackBlocks().
+    volatile int64_t blocks;
+  };
+
+  static int64_t PackBlocks(int64_t next, int64_t end) { return (next << 32) | end; }
+  static int64_t NextBlock(int64_t blocks) { return blocks >> 32; }
+  static int64_t EndBlock(int64_t blocks) { return blocks & 0xffffffffL; }
+
+  // Decompressed bytes of the boundary blocks kept for all files of a scan node,
+  // bounded by --lzo_boundary_block_bytes. Updated with atomic adds.
+  struct BoundaryBudget {
+    BoundaryBudget() : bytes(0) {}
+    int64_t bytes;
+  };
+
+  // The decompressed block at a range boundary, left by the first of the two
+  // scanners that pass it. See PassBoundary().
+  struct BoundaryBlock {
+    // Pool holding data, charged to the query's memory limits. NULL if the block is
+    // not kept, because it did not fit in the budget or was not decompressed.
+    MemPool* pool;
+    uint8_t* data;
+    int32_t len;
+  };
+
   // Header informatation, shared by all scanners on this file.
   struct LzoFileHeader {
     LzoChecksum input_checksum_type_;
@@ -133,37 +232,199 @@ class HdfsLzoTextScanner : public HdfsTextScanner {
 
     uint32_t header_size_;
 
+    // Block reader for this file's checksum configuration, set by ReadHeader().
+    ReadBlockFn read_block_fn_;
+
     // Offsets to compressed blocks. 
     std::vector<int64_t> offsets;
+
+    // True if only sampled blocks of this file are scanned, one range per block.
+    bool sampled;
+
+    // True if this is an incremental scan, see --lzo_incremental_scan. The scan
+    // stops after the last block in offsets.
+    bool incremental;
+
+    // LzoIndexCache cursors of the splits, copied when the header was read.
+    std::map<int64_t, int64_t> cursors;
+
+    // Protects active_ranges, extra_ranges and boundary_blocks. Stealers hold it to
+    // pick a victim, the scanners of the ranges do not take it.
+    boost::mutex lock;
+
+    // Ranges of this file currently being scanned.
+    std::list<ActiveRange*> active_ranges;
+
+    // Ranges issued for stolen or sampled blocks that have not been closed yet.
+    // These are not part of the initial splits and are not reported to
+    // RangeComplete().
+    std::set<DiskIoMgr::ScanRange*> extra_ranges;
+
+    // Initial splits that are done but not reported to RangeComplete() yet because
+    // extra_ranges is not empty. See CompleteSplits().
+    int deferred_splits;
+
+    // Blocks at range boundaries that only one of the two adjacent scanners has
+    // passed, keyed by block offset.
+    std::map<int64_t, BoundaryBlock> boundary_blocks;
+
+    // Budget of the scan node shared by the blocks in boundary_blocks.
+    BoundaryBudget* boundary_budget;
+
+    // Frees the blocks left by scanners whose neighbours never ran.
+    ~LzoFileHeader();
   };
 
   // Pointer to shared header information.
   LzoFileHeader* header_;
 
+  // This scanner's entry in header_->active_ranges.
+  ActiveRange active_range_;
+
+  // True if active_range_ is in header_->active_ranges.
+  bool range_registered_;
+
+  // True if the blocks at the boundaries of this range are shared with the
+  // scanners of the adjacent ranges.
+  bool share_boundaries_;
+
+  // Offsets of the first block of the range and of the first block past its end if
+  // they are shared with an adjacent range and the scanner has not passed them yet,
+  // -1 otherwise. end_boundary_ is set once the end of the range is final, when the
+  // scanner reads past it or is closed.
+  int64_t start_boundary_;
+  int64_t end_boundary_;
+
   // Fills the byte buffer by reading and decompressing blocks.
   virtual Status FillByteBuffer(bool* eosr, int num_bytes = 0);
 
   // Read header data and validate header.
   Status ReadHeader();
 
-  // Checksum data.
-  Status Checksum(LzoChecksum type,
-    const std::string& source, int expected_checksum, uint8_t* buffer, int length);
+  // Checksum data with the TYPE checksum, which must not be CHECK_NONE.
+  template <LzoChecksum TYPE>
+  Status Checksum(const char* source, int expected_checksum, uint8_t* buffer,
+      int length);
 
   // Read the index file and set up the header.offsets.
   Status ReadIndexFile();
 
+  // Set up header.offsets from the LzoIndexCache or the index file, and add the
+  // blocks appended to the file after the last known block.
+  Status ReadBlockOffsets();
+
   // Adjust the context_ to the first block at or after the current context offset.
-  Status FindFirstBlock();
+  // If skip_block_at_offset is true, a block starting exactly at the current offset
+  // is skipped as well. This is used to move past a bad block.
+  Status FindFirstBlock(bool skip_block_at_offset);
+
+  // Returns true if the scan range is complete: either the stream is at eosr or the
+  // rest of the range has been stolen by another scanner. Otherwise the block at
+  // the current offset is claimed, so it cannot be stolen anymore.
+  bool AtRangeEnd();
+
+  // Set up active_range_ and the boundaries of this scanner's range, and add the
+  // range to header_->active_ranges so others can steal from it.
+  void RegisterRange();
+
+  // Remove this scanner's range from header_->active_ranges.
+  void UnregisterRange();
+
+  // Steal the second half of the remaining blocks of the range with the most
+  // blocks left and issue a scan range for them.
+  Status StealBlocks();
+
+  // Report num_splits initial splits of the file complete, and remove extra_range
+  // from header_->extra_ranges if it is not NULL. The scan node is done once all
+  // splits are complete, so while extra ranges of the file are open the splits are
+  // only reported when the last of them is closed.
+  void CompleteSplits(int num_splits, DiskIoMgr::ScanRange* extra_range);
 
   // Issue the full file ranges after reading the headers.
   Status IssueFileRanges(const char* filename);
 
+  // Issue one scan range for each sampled block instead of the file's splits.
+  Status IssueSampledRanges(HdfsFileDesc* file_desc);
+
+  // Issue the parts of the file's splits from their cursors on. Splits whose records
+  // have all been returned are reported complete.
+  Status IssueIncrementalRanges(HdfsFileDesc* file_desc);
+
+  // Returns the split of this impalad that contains the start of the scan range,
+  // NULL if there is none.
+  const DiskIoMgr::ScanRange* GetSplit();
+
+  // Returns the cursor of 'split' in header_->cursors, -1 if it has none.
+  int64_t SplitCursor(const DiskIoMgr::ScanRange* split);
+
+  // Store the cursor of the split in the LzoIndexCache once its range has been
+  // scanned to the end. Nothing is stored if the scan stopped early.
+  void AdvanceCursor();
+
+  // Drop the records of the block at the split's cursor that the previous
+  // incremental scan returned. The block is left starting at its last line
+  // delimiter, which ends the partial first record the text scanner skips.
+  void SkipToCursor();
+
+  // Drop the partial last record of the last block of an incremental scan. The next
+  // incremental scan reads it.
+  void TrimLastBlock();
+
+  // Drop the partial last record of a sampled block that starts at block_offset.
+  // The rest of the record is in a block that is not read.
+  void TrimSampledBlock(int64_t block_offset);
+
   // Read a data block.
   // sets: byte_buffer_ptr_, byte_buffer_read_size_ and eos_read_.
   // Data will be in a mempool allocated buffer or in the disk I/O context memory
   // if the data was not compressed.
-  Status ReadAndDecompressData();
+  Status ReadAndDecompressData() { return (this->*header_->read_block_fn_)(); }
+
+  // Implementation of ReadAndDecompressData() for files whose compressed and
+  // uncompressed data carry INPUT and OUTPUT checksums. VERIFY is false if
+  // checksums are disabled. This keeps the per-block framing free of branches on
+  // the file's configuration.
+  template <LzoChecksum INPUT, LzoChecksum OUTPUT, bool VERIFY>
+  Status ReadAndDecompressBlock();
+
+  // Finish reading a block that was stored without compression.
+  template <LzoChecksum OUTPUT, bool VERIFY>
+  Status ReadStoredBlock(int64_t block_offset, int64_t trace_start, int32_t len,
+      int32_t checksum);
+
+  // Returns the block reader for the checksum types of the file.
+  ReadBlockFn SelectBlockReader(LzoChecksum input, LzoChecksum output);
+
+  // Make block_buffer_ at least len bytes long.
+  void AllocateBlockBuffer(int32_t len);
+
+  // Returns the scan node's BoundaryBudget, creating it for the first file.
+  BoundaryBudget* GetBoundaryBudget();
+
+  // Returns the offset of the first block past the end of the range if it is shared
+  // with the next range, -1 otherwise.
+  int64_t EndBoundary() const;
+
+  // Called at the boundary block *boundary before its compressed data is read. If
+  // the scanner of the adjacent range has passed the block already, its entry is
+  // removed and *boundary is set to -1. If that scanner kept the decompressed
+  // block, it is copied to the block buffer, the compressed data is skipped and
+  // *taken is set. Otherwise the stream is left at the compressed data.
+  Status TakeBoundaryBlock(int64_t* boundary, int32_t uncompressed_len,
+      int32_t compressed_len, bool* taken);
+
+  // Called with the block just decompressed from *boundary if TakeBoundaryBlock()
+  // did not find it. Keeps a copy for the scanner of the adjacent range, or drops
+  // the copy that scanner kept in the meantime.
+  void PublishBoundaryBlock(int64_t* boundary);
+
+  // Pass the boundary block *boundary without reading it. The first of the two
+  // adjacent scanners to pass a block leaves an entry for it, the second one
+  // removes the entry. Sets *boundary to -1.
+  void PassBoundary(int64_t* boundary);
+
+  // Free the data of a block removed from header_->boundary_blocks.
+  void ReleaseBoundaryBlock(const BoundaryBlock& block);
 
   // Read compress data and recover from errosr.
   Status ReadData();
@@ -190,6 +451,13 @@ class HdfsLzoTextScanner : public HdfsTextScanner {
   // True if the end of scan has been read.
   bool eos_read_;
 
+  // True if the range starts at the split's cursor and the first block has not
+  // been read yet.
+  bool skip_to_cursor_;
+
+  // True if the last block of an incremental scan has been read.
+  bool last_block_read_;
+
   // True if we are parsing the header for this scanner.
   bool only_parsing_header_;
 
@@ -199,6 +467,32 @@ class HdfsLzoTextScanner : public HdfsTextScanner {
 
   // Time spent decompressing
   RuntimeProfile::Counter* decompress_timer_;
+
+  // Number of blocks copied from the scanner of an adjacent range.
+  RuntimeProfile::Counter* boundary_blocks_reused_counter_;
+
+  // Process-wide LZO metrics, updated with scan_stats_ when the scanner is closed.
+  LzoMetrics* metrics_;
+  LzoMetrics::ScanStats scan_stats_;
+
+  // Time spent in lzo1x_decompress_safe().
+  MonotonicStopWatch decompress_watch_;
+
+  // File offset at which the scanner started reading past the end of its range.
+  int64_t past_eosr_offset_;
+
+  // Drops records that cannot pass the conjuncts. NULL if there is nothing to
+  // search for or --lzo_prefilter is off.
+  boost::scoped_ptr<LzoBlockPrefilter> prefilter_;
+
+  // Decompressed bytes removed by prefilter_.
+  RuntimeProfile::Counter* prefilter_bytes_counter_;
+
+  // Per-block event timeline, NULL unless --lzo_trace_dir is set.
+  boost::scoped_ptr<LzoTraceBuffer> trace_;
+
+  // Returns the start time for a trace event, or 0 if tracing is off.
+  int64_t TraceStart() const { return trace_ == NULL ? 0 : LzoTraceBuffer::Now(); }
 };
 }
 #endif
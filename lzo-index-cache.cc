@@ -0,0 +1,105 @@
+// Copyright (c) 2012 Cloudera, Inc. All rights reserved.
+
+#include "lzo-index-cache.h"
+
+#include <algorithm>
+#include <gflags/gflags.h>
+#include <boost/thread/locks.hpp>
+#include "runtime/mem-limit.h"
+
+using namespace boost;
+using namespace impala;
+using namespace std;
+
+DEFINE_int64(lzo_index_cache_bytes, 64L * 1024L * 1024L,
+    "Maximum memory used to cache the block offsets of LZO files across queries. "
+    "0 disables the cache.");
+
+namespace impala {
+
+const int64_t LzoIndexCache::SPLIT_SCANNED;
+
+LzoIndexCache* LzoIndexCache::GetInstance(MemLimit* mem_limit) {
+  static LzoIndexCache cache(mem_limit);
+  return &cache;
+}
+
+LzoIndexCache::LzoIndexCache(MemLimit* mem_limit)
+    : bytes_(0) {
+  if (mem_limit != NULL) mem_limits_.push_back(mem_limit);
+}
+
+bool LzoIndexCache::Lookup(const string& filename, Entry* entry) {
+  lock_guard<mutex> l(lock_);
+  EntryMap::iterator it = entries_.find(filename);
+  if (it == entries_.end()) return false;
+  *entry = it->second.entry;
+  return true;
+}
+
+int64_t LzoIndexCache::EntryBytes(const string& filename, const Entry& entry) {
+  // A map node holds the key, the value and about four pointers.
+  return sizeof(CachedEntry) + 2 * filename.size() +
+      entry.offsets.size() * sizeof(int64_t) +
+      entry.cursors.size() * (2 * sizeof(int64_t) + 4 * sizeof(void*));
+}
+
+void LzoIndexCache::Update(const string& filename, const Entry& entry) {
+  Entry new_entry = entry;
+  lock_guard<mutex> l(lock_);
+  EntryMap::iterator it = entries_.find(filename);
+  if (it != entries_.end()) {
+    // A scan may have completed splits since 'entry' was looked up.
+    const map<int64_t, int64_t>& cursors = it->second.entry.cursors;
+    for (map<int64_t, int64_t>::const_iterator c = cursors.begin();
+         c != cursors.end(); ++c) {
+      int64_t& cursor = new_entry.cursors[c->first];
+      cursor = max(cursor, c->second);
+    }
+    Erase(it);
+  }
+  int64_t entry_bytes = EntryBytes(filename, new_entry);
+  if (entry_bytes > FLAGS_lzo_index_cache_bytes) return;
+  while (bytes_ + entry_bytes > FLAGS_lzo_index_cache_bytes) {
+    Erase(entries_.find(insertion_order_.front()));
+  }
+  CachedEntry& cached = entries_[filename];
+  cached.entry = new_entry;
+  cached.order = insertion_order_.insert(insertion_order_.end(), filename);
+  cached.bytes = entry_bytes;
+  bytes_ += entry_bytes;
+  MemLimit::UpdateLimits(entry_bytes, &mem_limits_);
+}
+
+void LzoIndexCache::AdvanceCursor(const string& filename, int64_t split_offset,
+    int64_t cursor) {
+  lock_guard<mutex> l(lock_);
+  EntryMap::iterator it = entries_.find(filename);
+  if (it == entries_.end()) return;
+  CachedEntry& cached = it->second;
+  map<int64_t, int64_t>::iterator c = cached.entry.cursors.find(split_offset);
+  if (c != cached.entry.cursors.end()) {
+    c->second = max(c->second, cursor);
+    return;
+  }
+  cached.entry.cursors[split_offset] = cursor;
+  int64_t entry_bytes = EntryBytes(filename, cached.entry);
+  bytes_ += entry_bytes - cached.bytes;
+  MemLimit::UpdateLimits(entry_bytes - cached.bytes, &mem_limits_);
+  cached.bytes = entry_bytes;
+}
+
+void LzoIndexCache::Remove(const string& filename) {
+  lock_guard<mutex> l(lock_);
+  EntryMap::iterator it = entries_.find(filename);
+  if (it != entries_.end()) Erase(it);
+}
+
+void LzoIndexCache::Erase(EntryMap::iterator it) {
+  bytes_ -= it->second.bytes;
+  MemLimit::UpdateLimits(-it->second.bytes, &mem_limits_);
+  insertion_order_.erase(it->second.order);
+  entries_.erase(it);
+}
+
+}
@@ -0,0 +1,105 @@
+// Copyright (c) 2012 Cloudera, Inc. All rights reserved.
+
+#ifndef IMPALA_LZO_INDEX_CACHE_H
+#define IMPALA_LZO_INDEX_CACHE_H
+
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <boost/thread/mutex.hpp>
+
+namespace impala {
+
+class MemLimit;
+
+// Process-wide cache of the block offsets of LZO files, keyed by file name.
+// Files written by log collectors keep growing after they have been indexed, so an
+// entry remembers how much of the file it covers. A later scan of the same file
+// only has to find the blocks appended after 'tail' instead of reading the index
+// file again.
+// For --lzo_incremental_scan, an entry also remembers how far each split of the
+// file has been scanned on this impalad.
+// The cache holds at most --lzo_index_cache_bytes of entries and evicts the oldest
+// entries when it is full. Its memory is charged to the process memory limit.
+class LzoIndexCache {
+ public:
+  struct Entry {
+    // Length of the file when the offsets were computed.
+    int64_t file_length;
+
+    // End of the last block in offsets. The next appended block starts here.
+    int64_t tail;
+
+    // Offsets to compressed blocks.
+    std::vector<int64_t> offsets;
+
+    // Cursors of the splits that incremental scans have completed, keyed by split
+    // offset. A cursor is the offset of the last block of the file when the split
+    // was scanned, whose records up to the last line delimiter have been returned,
+    // or SPLIT_SCANNED if all records that start in the split have been returned.
+    std::map<int64_t, int64_t> cursors;
+
+    Entry() : file_length(0), tail(0) { }
+  };
+
+  // Cursor of a split whose records have all been returned.
+  static const int64_t SPLIT_SCANNED = 0x7fffffffffffffffLL;
+
+  // Returns the process-wide cache. On the first call, the cache is created and
+  // charges its memory to 'mem_limit', which may be NULL.
+  static LzoIndexCache* GetInstance(MemLimit* mem_limit);
+
+  // Copy the entry for 'filename' into 'entry'. Returns false if there is none.
+  bool Lookup(const std::string& filename, Entry* entry);
+
+  // Add or replace the entry for 'filename'. Entries larger than the cache are not
+  // added. Cursors of the replaced entry that are further than the ones in 'entry'
+  // are kept.
+  void Update(const std::string& filename, const Entry& entry);
+
+  // Move the cursor of the split at 'split_offset' of 'filename' forward to
+  // 'cursor'. Does nothing if the file has no entry.
+  void AdvanceCursor(const std::string& filename, int64_t split_offset,
+      int64_t cursor);
+
+  // Drop the entry for 'filename', if any.
+  void Remove(const std::string& filename);
+
+ private:
+  struct CachedEntry {
+    Entry entry;
+
+    // Position of the file name in insertion_order_.
+    std::list<std::string>::iterator order;
+
+    // Approximate memory used by the entry.
+    int64_t bytes;
+  };
+  typedef std::map<std::string, CachedEntry> EntryMap;
+
+  LzoIndexCache(MemLimit* mem_limit);
+
+  // Approximate memory used by an entry for 'filename'.
+  static int64_t EntryBytes(const std::string& filename, const Entry& entry);
+
+  // Drop the entry at 'it' and release its memory. lock_ must be held.
+  void Erase(EntryMap::iterator it);
+
+  boost::mutex lock_;
+
+  EntryMap entries_;
+
+  // File names in the order they were added, oldest first.
+  std::list<std::string> insertion_order_;
+
+  // Memory used by entries_.
+  int64_t bytes_;
+
+  // Process memory limit the entries are charged to. Empty if there is none.
+  std::vector<MemLimit*> mem_limits_;
+};
+
+}
+#endif
@@ -0,0 +1,108 @@
+// Copyright (c) 2012 Cloudera, Inc. All rights reserved.
+
+#include "lzo-metrics.h"
+
+#include <string.h>
+#include <sstream>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+
+using namespace boost;
+using namespace impala;
+using namespace std;
+
+const int LzoMetrics::THROUGHPUT_BUCKETS_MBPS[] = { 50, 100, 200, 300, 400, 600, 800 };
+const int LzoMetrics::BLOCK_SIZE_BUCKETS_KB[] = { 16, 64, 128, 256, 1024 };
+
+// Protects the creation of the instance.
+static mutex instance_lock;
+static LzoMetrics* instance = NULL;
+
+// Returns the name of bucket i of a histogram with the given upper bounds.
+static string BucketName(const string& prefix, const int* bounds, int num_buckets,
+    int i, const char* unit) {
+  stringstream ss;
+  ss << prefix;
+  if (i < num_buckets - 1) {
+    ss << "lt-" << bounds[i] << unit;
+  } else {
+    ss << "ge-" << bounds[num_buckets - 2] << unit;
+  }
+  return ss.str();
+}
+
+namespace impala {
+
+LzoMetrics::ScanStats::ScanStats()
+    : decompressed_bytes(0),
+      decompress_time_ns(0),
+      past_eosr_bytes(0),
+      recovered_errors(0) {
+  memset(block_sizes, 0, sizeof(block_sizes));
+}
+
+void LzoMetrics::ScanStats::AddBlock(int len) {
+  int i = 0;
+  while (i < NUM_BLOCK_SIZE_BUCKETS - 1 && len >= BLOCK_SIZE_BUCKETS_KB[i] * 1024) ++i;
+  ++block_sizes[i];
+}
+
+LzoMetrics* LzoMetrics::GetInstance(Metrics* metrics) {
+  lock_guard<mutex> l(instance_lock);
+  if (instance == NULL) instance = new LzoMetrics(metrics);
+  return instance;
+}
+
+LzoMetrics::LzoMetrics(Metrics* metrics) {
+  unindexed_files_ =
+      metrics->CreateAndRegisterPrimitiveMetric("lzo.unindexed-files", 0L);
+  index_cache_hits =
+      metrics->CreateAndRegisterPrimitiveMetric("lzo.index-cache.hits", 0L);
+  index_cache_misses =
+      metrics->CreateAndRegisterPrimitiveMetric("lzo.index-cache.misses", 0L);
+  decompressed_bytes_ =
+      metrics->CreateAndRegisterPrimitiveMetric("lzo.decompressed-bytes", 0L);
+  past_eosr_bytes_ =
+      metrics->CreateAndRegisterPrimitiveMetric("lzo.read-past-eosr-bytes", 0L);
+  recovered_errors_ =
+      metrics->CreateAndRegisterPrimitiveMetric("lzo.recovered-errors", 0L);
+  for (int i = 0; i < NUM_THROUGHPUT_BUCKETS; ++i) {
+    throughput_.push_back(metrics->CreateAndRegisterPrimitiveMetric(
+        BucketName("lzo.decompress-throughput.", THROUGHPUT_BUCKETS_MBPS,
+            NUM_THROUGHPUT_BUCKETS, i, "mbps"), 0L));
+  }
+  for (int i = 0; i < NUM_BLOCK_SIZE_BUCKETS; ++i) {
+    block_sizes_.push_back(metrics->CreateAndRegisterPrimitiveMetric(
+        BucketName("lzo.block-size.", BLOCK_SIZE_BUCKETS_KB,
+            NUM_BLOCK_SIZE_BUCKETS, i, "kb"), 0L));
+  }
+}
+
+void LzoMetrics::SetUnindexed(const string& filename, bool unindexed) {
+  lock_guard<mutex> l(unindexed_lock_);
+  if (unindexed) {
+    if (!unindexed_filenames_.insert(filename).second) return;
+  } else {
+    // An index file may have been created since the last scan.
+    if (unindexed_filenames_.erase(filename) == 0) return;
+  }
+  unindexed_files_->Update(unindexed_filenames_.size());
+}
+
+void LzoMetrics::Update(const ScanStats& stats) {
+  if (stats.decompressed_bytes > 0 && stats.decompress_time_ns > 0) {
+    decompressed_bytes_->Increment(stats.decompressed_bytes);
+    // Bytes per nanosecond times 1000 is MB/s.
+    double mbps = stats.decompressed_bytes * 1000.0 / stats.decompress_time_ns;
+    int i = 0;
+    while (i < NUM_THROUGHPUT_BUCKETS - 1 && mbps >= THROUGHPUT_BUCKETS_MBPS[i]) ++i;
+    throughput_[i]->Increment(1L);
+  }
+  if (stats.past_eosr_bytes > 0) past_eosr_bytes_->Increment(stats.past_eosr_bytes);
+  if (stats.recovered_errors > 0) recovered_errors_->Increment(stats.recovered_errors);
+  for (int i = 0; i < NUM_BLOCK_SIZE_BUCKETS; ++i) {
+    if (stats.block_sizes[i] > 0) block_sizes_[i]->Increment(stats.block_sizes[i]);
+  }
+}
+
+}
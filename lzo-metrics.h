@@ -0,0 +1,89 @@
+// Copyright (c) 2012 Cloudera, Inc. All rights reserved.
+
+#ifndef IMPALA_LZO_METRICS_H
+#define IMPALA_LZO_METRICS_H
+
+#include <set>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <boost/thread/mutex.hpp>
+#include "util/metrics.h"
+
+namespace impala {
+
+// Process-wide metrics aggregated over all LZO scanners, registered with the
+// impalad's Metrics so they show up on the /metrics debug page.
+// Scanners collect their numbers in a ScanStats and add them once, when they are
+// closed, so the shared metrics are not updated per block.
+class LzoMetrics {
+ public:
+  // Upper bounds of the decompression throughput buckets in MB/s. The last bucket
+  // counts everything faster.
+  static const int NUM_THROUGHPUT_BUCKETS = 8;
+  static const int THROUGHPUT_BUCKETS_MBPS[NUM_THROUGHPUT_BUCKETS - 1];
+
+  // Upper bounds of the uncompressed block size buckets in KB. The last bucket
+  // counts everything larger.
+  static const int NUM_BLOCK_SIZE_BUCKETS = 6;
+  static const int BLOCK_SIZE_BUCKETS_KB[NUM_BLOCK_SIZE_BUCKETS - 1];
+
+  // Numbers collected by one scanner.
+  struct ScanStats {
+    // Bytes produced by decompression and the time it took.
+    int64_t decompressed_bytes;
+    int64_t decompress_time_ns;
+
+    // Compressed bytes read past the end of the scan range.
+    int64_t past_eosr_bytes;
+
+    // Bad blocks skipped.
+    int64_t recovered_errors;
+
+    // Number of blocks read per size bucket.
+    int64_t block_sizes[NUM_BLOCK_SIZE_BUCKETS];
+
+    ScanStats();
+
+    // Count a block with 'len' bytes of uncompressed data.
+    void AddBlock(int len);
+  };
+
+  // Returns the process-wide instance, registering the metrics with 'metrics' on
+  // the first call.
+  static LzoMetrics* GetInstance(Metrics* metrics);
+
+  // Add the numbers of a finished scanner.
+  void Update(const ScanStats& stats);
+
+  // Record whether a header scan found an index file for 'filename'.
+  void SetUnindexed(const std::string& filename, bool unindexed);
+
+  // Lookups of the block offsets of indexed files in the LzoIndexCache.
+  Metrics::IntMetric* index_cache_hits;
+  Metrics::IntMetric* index_cache_misses;
+
+ private:
+  LzoMetrics(Metrics* metrics);
+
+  // Files that had no index file when they were last scanned, so they could not be
+  // split. Each file is counted once.
+  Metrics::IntMetric* unindexed_files_;
+
+  // Protects unindexed_filenames_.
+  boost::mutex unindexed_lock_;
+  std::set<std::string> unindexed_filenames_;
+
+  Metrics::IntMetric* decompressed_bytes_;
+  Metrics::IntMetric* past_eosr_bytes_;
+  Metrics::IntMetric* recovered_errors_;
+
+  // Number of scanners per decompression throughput bucket.
+  std::vector<Metrics::IntMetric*> throughput_;
+
+  // Number of blocks per size bucket.
+  std::vector<Metrics::IntMetric*> block_sizes_;
+};
+
+}
+#endif
@@ -0,0 +1,179 @@
+// Copyright (c) 2012 Cloudera, Inc. All rights reserved.
+
+#include "lzo-prefilter.h"
+
+#include <string.h>
+#include <nmmintrin.h>
+#include <algorithm>
+#include "exec/hdfs-scan-node.h"
+#include "exprs/expr.h"
+#include "exprs/slot-ref.h"
+#include "runtime/descriptors.h"
+#include "runtime/runtime-state.h"
+#include "runtime/string-value.h"
+
+#include "gen-cpp/Opcodes_types.h"
+
+using namespace impala;
+using namespace std;
+
+// Needles shorter than this filter too little to be worth searching for.
+static const int MIN_NEEDLE_LEN = 3;
+
+// Returns true if longer needles should be searched for first.
+static bool LongerThan(const string& a, const string& b) {
+  return a.size() > b.size();
+}
+
+// Returns the longest part of a LIKE pattern that has no wildcards, or "" if the
+// pattern uses escapes.
+static string LongestLiteral(const StringValue& pattern) {
+  string longest;
+  const char* end = pattern.ptr + pattern.len;
+  const char* start = pattern.ptr;
+  for (const char* p = pattern.ptr; p <= end; ++p) {
+    if (p < end && *p == '\\') return "";
+    if (p == end || *p == '%' || *p == '_') {
+      if (p - start > longest.size()) longest.assign(start, p - start);
+      start = p + 1;
+    }
+  }
+  return longest;
+}
+
+// If 'expr' is a reference to a string column stored in the file, returns true.
+// Partition key columns are not in the file text.
+static bool IsFileStringSlot(Expr* expr, HdfsScanNode* scan_node, RuntimeState* state) {
+  SlotRef* slot_ref = dynamic_cast<SlotRef*>(expr);
+  if (slot_ref == NULL) return false;
+  const SlotDescriptor* slot = state->desc_tbl().GetSlotDescriptor(slot_ref->slot_id());
+  return slot != NULL && slot->type() == TYPE_STRING &&
+      slot->col_pos() >= scan_node->hdfs_table()->num_clustering_cols();
+}
+
+// Returns the value of a constant string expr, or NULL.
+static StringValue* GetConstantString(Expr* expr) {
+  if (!expr->IsConstant()) return NULL;
+  return reinterpret_cast<StringValue*>(expr->GetValue(NULL));
+}
+
+namespace impala {
+
+LzoBlockPrefilter* LzoBlockPrefilter::Create(HdfsScanNode* scan_node,
+    RuntimeState* state, const HdfsPartitionDescriptor* partition) {
+  // With escapes, the text of a field can differ from its value.
+  if (partition->escape_char() != '\0') return NULL;
+
+  vector<string> needles;
+  const vector<Expr*>& conjuncts = scan_node->conjuncts();
+  for (int i = 0; i < conjuncts.size(); ++i) {
+    Expr* conjunct = conjuncts[i];
+    if (conjunct->GetNumChildren() != 2) continue;
+    Expr* lhs = conjunct->GetChild(0);
+    Expr* rhs = conjunct->GetChild(1);
+    string needle;
+    if (conjunct->op() == TExprOpcode::LIKE) {
+      if (!IsFileStringSlot(lhs, scan_node, state)) continue;
+      StringValue* pattern = GetConstantString(rhs);
+      if (pattern == NULL) continue;
+      needle = LongestLiteral(*pattern);
+    } else if (conjunct->op() == TExprOpcode::EQ_STRING_STRING) {
+      if (!IsFileStringSlot(lhs, scan_node, state)) swap(lhs, rhs);
+      if (!IsFileStringSlot(lhs, scan_node, state)) continue;
+      StringValue* literal = GetConstantString(rhs);
+      if (literal == NULL) continue;
+      needle.assign(literal->ptr, literal->len);
+    } else {
+      continue;
+    }
+    // A field cannot contain the delimiters, leave such predicates to the parser.
+    if (needle.size() < MIN_NEEDLE_LEN) continue;
+    if (needle.find(partition->line_delim()) != string::npos) continue;
+    if (needle.find(partition->field_delim()) != string::npos) continue;
+    needles.push_back(needle);
+  }
+  if (needles.empty()) return NULL;
+  VLOG_FILE << "LZO prefilter on " << needles.size() << " needle(s), searching for '"
+            << *max_element(needles.begin(), needles.end(), LongerThan) << "'";
+  return new LzoBlockPrefilter(needles, partition->line_delim());
+}
+
+LzoBlockPrefilter::LzoBlockPrefilter(const vector<string>& needles, char tuple_delim)
+    : needles_(needles),
+      tuple_delim_(tuple_delim) {
+  sort(needles_.begin(), needles_.end(), LongerThan);
+  search_prefix_len_ = min<int>(needles_[0].size(), sizeof(search_prefix_));
+  memset(search_prefix_, 0, sizeof(search_prefix_));
+  memcpy(search_prefix_, needles_[0].data(), search_prefix_len_);
+}
+
+const uint8_t* LzoBlockPrefilter::Search(const uint8_t* begin, const uint8_t* end) const {
+  const string& needle = needles_[0];
+  const __m128i prefix = _mm_load_si128(reinterpret_cast<const __m128i*>(search_prefix_));
+  const uint8_t* p = begin;
+  // Find candidates 16 bytes at a time. An index below 16 is either a full match
+  // of the prefix or a partial match that runs off the end of the chunk.
+  while (p + sizeof(__m128i) <= end) {
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    int idx = _mm_cmpestri(prefix, search_prefix_len_, chunk, sizeof(__m128i),
+        _SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ORDERED);
+    if (idx == sizeof(__m128i)) {
+      p += sizeof(__m128i);
+      continue;
+    }
+    p += idx;
+    if (p + needle.size() > end) return NULL;
+    if (memcmp(p, needle.data(), needle.size()) == 0) return p;
+    ++p;
+  }
+  for (; p + needle.size() <= end; ++p) {
+    if (memcmp(p, needle.data(), needle.size()) == 0) return p;
+  }
+  return NULL;
+}
+
+bool LzoBlockPrefilter::ContainsOtherNeedles(const uint8_t* begin,
+    const uint8_t* end) const {
+  for (int i = 1; i < needles_.size(); ++i) {
+    if (memmem(begin, end - begin, needles_[i].data(), needles_[i].size()) == NULL) {
+      return false;
+    }
+  }
+  return true;
+}
+
+int LzoBlockPrefilter::Filter(uint8_t* data, int len) {
+  uint8_t* end = data + len;
+  uint8_t* first_delim = reinterpret_cast<uint8_t*>(memchr(data, tuple_delim_, len));
+  if (first_delim == NULL) return len;
+  // The bytes up to the first delimiter finish a record from the previous block and
+  // those after the last delimiter start one that continues in the next block.
+  uint8_t* records_end =
+      reinterpret_cast<uint8_t*>(memrchr(data, tuple_delim_, len)) + 1;
+
+  uint8_t* out = first_delim + 1;
+  uint8_t* record = first_delim + 1;
+  while (record < records_end) {
+    const uint8_t* match = Search(record, records_end);
+    if (match == NULL) break;
+    // Widen the match to its record. records_end - 1 is a delimiter, so the end
+    // of the record is always found.
+    const uint8_t* prev_delim = reinterpret_cast<const uint8_t*>(
+        memrchr(record, tuple_delim_, match - record));
+    const uint8_t* next_delim = reinterpret_cast<const uint8_t*>(
+        memchr(match, tuple_delim_, records_end - match));
+    uint8_t* record_start =
+        prev_delim == NULL ? record : record + (prev_delim - record) + 1;
+    uint8_t* record_end = record + (next_delim - record) + 1;
+    if (ContainsOtherNeedles(record_start, record_end)) {
+      memmove(out, record_start, record_end - record_start);
+      out += record_end - record_start;
+    }
+    record = record_end;
+  }
+  memmove(out, records_end, end - records_end);
+  out += end - records_end;
+  return out - data;
+}
+
+}
@@ -0,0 +1,60 @@
+// Copyright (c) 2012 Cloudera, Inc. All rights reserved.
+
+#ifndef IMPALA_LZO_PREFILTER_H
+#define IMPALA_LZO_PREFILTER_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace impala {
+
+class HdfsPartitionDescriptor;
+class HdfsScanNode;
+class RuntimeState;
+
+// Drops records from a decompressed block before they are parsed, based on the
+// string literals that the scan's conjuncts require to be present in a row.
+// A conjunct of the form <string col> LIKE '<pattern>' requires the longest literal
+// part of the pattern to appear in the row's text, and <string col> = '<literal>'
+// requires the literal. Since all conjuncts must hold, a record that is missing any
+// of these needles cannot pass the scan and is removed.
+//
+// Blocks are searched for the longest needle with SSE4.2 string compares. The
+// other needles are only checked in the records that contain it. The partial
+// records at the start and end of a block are always kept: they belong to
+// records that span blocks.
+class LzoBlockPrefilter {
+ public:
+  // Returns a prefilter for the conjuncts of scan_node on the text of 'partition',
+  // or NULL if none of them can be checked on the raw text. Partitions can have
+  // different delimiters, so the prefilter is created per scan range. The caller
+  // owns the result.
+  static LzoBlockPrefilter* Create(HdfsScanNode* scan_node, RuntimeState* state,
+      const HdfsPartitionDescriptor* partition);
+
+  // Remove the complete records in data[0, len) that are missing a needle, moving
+  // the kept bytes to the front. Returns the number of bytes kept.
+  int Filter(uint8_t* data, int len);
+
+ private:
+  LzoBlockPrefilter(const std::vector<std::string>& needles, char tuple_delim);
+
+  // Returns the first occurrence of needles_[0] in [begin, end), or NULL.
+  const uint8_t* Search(const uint8_t* begin, const uint8_t* end) const;
+
+  // Returns true if [begin, end) contains all of the other needles.
+  bool ContainsOtherNeedles(const uint8_t* begin, const uint8_t* end) const;
+
+  // Needles that every row must contain, longest first.
+  std::vector<std::string> needles_;
+
+  // First bytes of needles_[0], at most 16, padded for the SSE compare.
+  uint8_t search_prefix_[16] __attribute__((aligned(16)));
+  int search_prefix_len_;
+
+  char tuple_delim_;
+};
+
+}
+#endif
@@ -0,0 +1,123 @@
+// Copyright (c) 2012 Cloudera, Inc. All rights reserved.
+
+#include "lzo-trace.h"
+
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sstream>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+#include "util/debug-util.h"
+
+using namespace boost;
+using namespace impala;
+using namespace std;
+
+// Serializes appends to the trace files from scanners on different threads.
+static mutex trace_file_lock;
+
+static const char* EVENT_NAMES[] = {
+  "read",
+  "decompress",
+  "boundary-reuse",
+  "prefilter",
+  "checksum",
+  "handoff",
+  "read-past-eosr",
+  "error-skip",
+  "steal",
+};
+
+// Escape a string for use inside a JSON string literal.
+static string JsonEscape(const string& s) {
+  string result;
+  result.reserve(s.size());
+  for (int i = 0; i < s.size(); ++i) {
+    if (s[i] == '"' || s[i] == '\\') result.push_back('\\');
+    result.push_back(s[i]);
+  }
+  return result;
+}
+
+namespace impala {
+
+LzoTraceBuffer::LzoTraceBuffer(const string& filename, const TUniqueId& fragment_id)
+    : filename_(filename),
+      fragment_id_(fragment_id),
+      tid_(syscall(SYS_gettid)) {
+}
+
+int64_t LzoTraceBuffer::Now() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000L + ts.tv_nsec / 1000;
+}
+
+void LzoTraceBuffer::AddEvent(EventType type, int64_t start, int64_t offset,
+    int64_t bytes) {
+  Event event;
+  event.type = type;
+  event.start = start;
+  event.duration = Now() - start;
+  event.offset = offset;
+  event.bytes = bytes;
+  events_.push_back(event);
+}
+
+void LzoTraceBuffer::AddInstant(EventType type, int64_t offset, int64_t bytes) {
+  Event event;
+  event.type = type;
+  event.start = Now();
+  event.duration = -1;
+  event.offset = offset;
+  event.bytes = bytes;
+  events_.push_back(event);
+}
+
+Status LzoTraceBuffer::Flush(const string& dir) {
+  if (events_.empty()) return Status::OK;
+
+  // Format outside of the lock.
+  stringstream ss;
+  string file = JsonEscape(filename_);
+  pid_t pid = getpid();
+  for (int i = 0; i < events_.size(); ++i) {
+    const Event& event = events_[i];
+    ss << "{\"name\":\"" << EVENT_NAMES[event.type] << "\",\"cat\":\"lzo\"";
+    if (event.duration < 0) {
+      ss << ",\"ph\":\"i\",\"s\":\"t\"";
+    } else {
+      ss << ",\"ph\":\"X\",\"dur\":" << event.duration;
+    }
+    ss << ",\"ts\":" << event.start << ",\"pid\":" << pid << ",\"tid\":" << tid_
+       << ",\"args\":{\"file\":\"" << file << "\",\"offset\":" << event.offset
+       << ",\"bytes\":" << event.bytes << "}},\n";
+  }
+  events_.clear();
+
+  string path = dir + "/lzo-trace-" + PrintId(fragment_id_) + ".json";
+  string data = ss.str();
+
+  lock_guard<mutex> l(trace_file_lock);
+  FILE* trace_file = fopen(path.c_str(), "a");
+  if (trace_file == NULL) {
+    stringstream err;
+    err << "Could not open LZO trace file: " << path;
+    return Status(err.str());
+  }
+  // A new file starts the JSON array.
+  fseek(trace_file, 0, SEEK_END);
+  if (ftell(trace_file) == 0) fputs("[\n", trace_file);
+  size_t written = fwrite(data.data(), 1, data.size(), trace_file);
+  int close_stat = fclose(trace_file);
+  if (written != data.size() || close_stat != 0) {
+    stringstream err;
+    err << "Error writing LZO trace file: " << path;
+    return Status(err.str());
+  }
+  return Status::OK;
+}
+
+}
@@ -0,0 +1,76 @@
+// Copyright (c) 2012 Cloudera, Inc. All rights reserved.
+
+#ifndef IMPALA_LZO_TRACE_H
+#define IMPALA_LZO_TRACE_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "common/status.h"
+#include "gen-cpp/Types_types.h"
+
+namespace impala {
+
+// Buffer of timestamped per-block events recorded by a single LZO scanner.
+// A scanner runs on one thread for the life of a scan range, so the buffer is
+// not locked; events are appended to a vector and only formatted when the
+// scanner is closed.
+//
+// Flush() appends the events to <dir>/lzo-trace-<fragment-instance-id>.json in the
+// Chrome trace-event array format (chrome://tracing). All scanners of a fragment
+// share the file. The closing ']' is never written, which the trace viewer accepts.
+class LzoTraceBuffer {
+ public:
+  enum EventType {
+    READ,             // Reading the block header and compressed bytes.
+    DECOMPRESS,       // lzo1x decompression of one block.
+    BOUNDARY_REUSE,   // Copying a block decompressed by an adjacent range's scanner.
+    PREFILTER,        // Dropping records that cannot match the predicates.
+    CHECKSUM,         // Checksumming the compressed or decompressed block.
+    HANDOFF,          // Decompressed bytes returned to the text parser (instant).
+    READ_PAST_EOSR,   // Started reading past the end of the scan range (instant).
+    ERROR_SKIP,       // Skipped forward to the next block after an error (instant).
+    STEAL,            // Stole blocks from another range of the file (instant).
+  };
+
+  // filename -- file being scanned, included in every event.
+  // fragment_id -- instance id of the fragment, used to name the output file.
+  LzoTraceBuffer(const std::string& filename, const TUniqueId& fragment_id);
+
+  // Monotonic timestamp in microseconds.
+  static int64_t Now();
+
+  // Record an event that started at 'start' and ends now.
+  // offset -- file offset the event refers to.
+  // bytes -- number of bytes involved, if any.
+  void AddEvent(EventType type, int64_t start, int64_t offset, int64_t bytes);
+
+  // Record an instant event.
+  void AddInstant(EventType type, int64_t offset, int64_t bytes);
+
+  // Append the buffered events to the fragment's trace file in 'dir' and clear
+  // the buffer.
+  Status Flush(const std::string& dir);
+
+ private:
+  struct Event {
+    EventType type;
+    int64_t start;
+    // Duration in microseconds, -1 for instant events.
+    int64_t duration;
+    int64_t offset;
+    int64_t bytes;
+  };
+
+  std::string filename_;
+  TUniqueId fragment_id_;
+
+  // Thread that created the buffer, used as the trace tid.
+  int64_t tid_;
+
+  std::vector<Event> events_;
+};
+
+}
+#endif
@@ -0,0 +1,518 @@
+// Copyright (c) 2012 Cloudera, Inc. All rights reserved.
+//
+// Replays scans of local lzop files through the LZO scanner, outside of impalad.
+// The scanner sources are linked against the stand-ins in replay/stand-in: a scan
+// node that runs the ranges issued by the plugin on a pool of scanner threads, a
+// scanner context that reads the local files in I/O buffers, a text scanner that
+// drives FillByteBuffer() and hashes the rows, and a local libhdfs for the index
+// and header reads.
+//
+// The rows of each scan are compared with the rows of an independent sequential
+// reader of the file:
+//  - full scans must return every row exactly once, whatever the split layout
+//  - sampled scans (--lzo_sample_percent < 100) must return a subset of the rows
+//  - the first incremental scan (--lzo_incremental_scan) of an indexed file must
+//    return its complete rows, the following ones nothing, as no data is appended
+// Each pass then reports the throughput, the bytes read and the peak memory of the
+// scan, and the scanner's counters and metrics.
+//
+// Usage: lzo-scan-replay [flags] <manifest>
+// Each manifest line describes one file and its split layout:
+//   <path> size=<bytes>             -- splits of a fixed size.
+//   <path> offsets=<o1>,<o2>,...    -- splits starting at the given offsets. 0 is
+//                                      always added.
+// Lines starting with '#' are ignored. All files are scanned by one scan node. The
+// exit status is non-zero if a scan failed or returned the wrong rows.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <hdfs.h>
+#include "common/logging.h"
+#include "exec/hdfs-scan-node.h"
+#include "exec/hdfs-text-scanner.h"
+#include "exprs/expr.h"
+#include "exprs/slot-ref.h"
+#include "runtime/descriptors.h"
+#include "runtime/exec-env.h"
+#include "runtime/runtime-state.h"
+#include "util/stopwatch.h"
+
+#include "lzo-header.h"
+
+using namespace impala;
+using namespace std;
+
+DEFINE_int32(replay_threads, 4, "Number of scanner threads of the scan node.");
+DEFINE_int32(replay_passes, 1,
+    "Number of times the files are scanned. The index cache, the incremental scan "
+    "cursors and the metrics are kept between passes, as in one impalad.");
+DEFINE_string(replay_row_contains, "",
+    "If set, the scan has the predicate line LIKE '%<literal>%', which the LZO "
+    "prefilter can use, and only the rows that contain the literal are expected.");
+
+DECLARE_int32(lzo_sample_percent);
+DECLARE_bool(lzo_incremental_scan);
+
+// The magic byte sequence at the beginning of an LZOP file.
+static const uint8_t LZOP_MAGIC[9] =
+    { 0x89, 0x4c, 0x5a, 0x4f, 0x00, 0x0d, 0x0a, 0x1a, 0x0a };
+
+static const int MIN_HEADER_SIZE = 32;
+static const int HEADER_SIZE = 300;
+static const char TUPLE_DELIM = '\n';
+
+// Rows printed for each file whose scan returned the wrong rows.
+static const int MAX_PRINTED_ROWS = 5;
+
+static uint32_t GetInt32(const uint8_t* buf) {
+  return (buf[0] << 24) | (buf[1] << 16) | (buf[2] << 8) | buf[3];
+}
+
+// Sequential reader of the rows of an lzop file. It shares no code with the
+// scanner and gives the rows a scan is expected to return.
+class ReferenceReader {
+ public:
+  ReferenceReader(const string& path, int64_t length)
+    : path_(path), length_(length), fd_(-1), offset_(0), pos_(0) {
+  }
+
+  ~ReferenceReader() {
+    if (fd_ != -1) close(fd_);
+  }
+
+  // Open the file and parse its header.
+  bool Open(string* error);
+
+  // Returns the next row in *row. *terminated is false for a last row without a
+  // line delimiter. Returns false at the end of the file, or on an error that is
+  // set in *error.
+  bool Next(string* row, bool* terminated, string* error);
+
+ private:
+  // Read 'len' bytes at the current offset.
+  bool Read(uint8_t* buf, int64_t len);
+
+  // Read and decompress the next block. Sets *eof at the end of the data.
+  bool ReadBlock(bool* eof, string* error);
+
+  string path_;
+  int64_t length_;
+  int fd_;
+  int64_t offset_;
+  bool output_checksum_;
+  bool input_checksum_;
+
+  // Decompressed block and the position of the next row in it.
+  vector<char> block_;
+  int64_t pos_;
+};
+
+bool ReferenceReader::Read(uint8_t* buf, int64_t len) {
+  if (offset_ + len > length_) return false;
+  for (int64_t done = 0; done < len;) {
+    ssize_t n = pread(fd_, buf + done, len - done, offset_ + done);
+    if (n <= 0) return false;
+    done += n;
+  }
+  offset_ += len;
+  return true;
+}
+
+bool ReferenceReader::Open(string* error) {
+  fd_ = open(path_.c_str(), O_RDONLY);
+  if (fd_ == -1) {
+    *error = strerror(errno);
+    return false;
+  }
+  uint8_t magic[HEADER_SIZE];
+  int len = min<int64_t>(HEADER_SIZE, length_);
+  if (len < MIN_HEADER_SIZE || !Read(magic, len)) {
+    *error = "file too short for an lzop header";
+    return false;
+  }
+  if (memcmp(magic, LZOP_MAGIC, sizeof(LZOP_MAGIC))) {
+    *error = "invalid lzop magic";
+    return false;
+  }
+  uint8_t* header = magic + sizeof(LZOP_MAGIC);
+  // Skip version, lib version, version needed, method and level.
+  uint8_t* h_ptr = header + 3 * sizeof(int16_t) + 2;
+  uint32_t flags = GetInt32(h_ptr);
+  output_checksum_ = (flags & (F_CRC32_D | F_ADLER32_D)) != 0;
+  input_checksum_ = (flags & (F_CRC32_C | F_ADLER32_C)) != 0;
+  if (flags & (F_RESERVED | F_MULTIPART | F_H_FILTER)) {
+    *error = "unsupported flags";
+    return false;
+  }
+  h_ptr += sizeof(int32_t);
+  // Skip mode and time fields and the file name.
+  h_ptr += 3 * sizeof(int32_t);
+  h_ptr += *h_ptr + 1;
+  // Skip the header checksum and the extra field.
+  h_ptr += sizeof(int32_t);
+  if (flags & F_H_EXTRA_FIELD) h_ptr += 2 * sizeof(int32_t) + GetInt32(h_ptr);
+  offset_ = h_ptr - magic;
+  return true;
+}
+
+bool ReferenceReader::ReadBlock(bool* eof, string* error) {
+  *eof = false;
+  if (offset_ >= length_) {
+    *eof = true;
+    return true;
+  }
+  int64_t block_offset = offset_;
+  uint8_t buf[2 * sizeof(int32_t)];
+  if (!Read(buf, sizeof(int32_t))) {
+    *error = "truncated block header";
+    return false;
+  }
+  uint32_t uncompressed_len = GetInt32(buf);
+  if (uncompressed_len == 0) {
+    *eof = true;
+    return true;
+  }
+  if (!Read(buf, sizeof(int32_t) + (output_checksum_ ? sizeof(int32_t) : 0))) {
+    *error = "truncated block header";
+    return false;
+  }
+  uint32_t compressed_len = GetInt32(buf);
+  if (compressed_len > uncompressed_len || uncompressed_len > LZO_MAX_BLOCK_SIZE) {
+    stringstream ss;
+    ss << "invalid block sizes @" << block_offset;
+    *error = ss.str();
+    return false;
+  }
+  if (compressed_len < uncompressed_len && input_checksum_) offset_ += sizeof(int32_t);
+  vector<uint8_t> compressed(compressed_len);
+  if (!Read(&compressed[0], compressed_len)) {
+    stringstream ss;
+    ss << "truncated block @" << block_offset;
+    *error = ss.str();
+    return false;
+  }
+  block_.resize(uncompressed_len);
+  pos_ = 0;
+  if (compressed_len == uncompressed_len) {
+    memcpy(&block_[0], &compressed[0], compressed_len);
+    return true;
+  }
+  lzo_uint out_len = uncompressed_len;
+  int ret = lzo1x_decompress_safe(&compressed[0], compressed_len,
+      reinterpret_cast<uint8_t*>(&block_[0]), &out_len, NULL);
+  if (ret != LZO_E_OK || out_len != uncompressed_len) {
+    stringstream ss;
+    ss << "decompression failed @" << block_offset << " returned: " << ret;
+    *error = ss.str();
+    return false;
+  }
+  return true;
+}
+
+bool ReferenceReader::Next(string* row, bool* terminated, string* error) {
+  row->clear();
+  bool in_row = false;
+  while (true) {
+    if (pos_ < block_.size()) {
+      const char* start = &block_[pos_];
+      const char* delim = reinterpret_cast<const char*>(
+          memchr(start, TUPLE_DELIM, block_.size() - pos_));
+      if (delim != NULL) {
+        row->append(start, delim - start);
+        pos_ += delim - start + 1;
+        *terminated = true;
+        return true;
+      }
+      row->append(start, block_.size() - pos_);
+      pos_ = block_.size();
+      in_row = true;
+    }
+    bool eof;
+    if (!ReadBlock(&eof, error)) return false;
+    if (eof) {
+      *terminated = false;
+      return in_row;
+    }
+  }
+}
+
+// A file of the manifest and the rows expected from it.
+struct ReplayFile {
+  string path;
+  int64_t length;
+  vector<int64_t> split_offsets;
+  // Incremental scans only apply to indexed files.
+  bool indexed;
+  int64_t uncompressed_bytes;
+  // Sorted hashes of all rows, and of the rows with a line delimiter.
+  vector<uint64_t> rows;
+  vector<uint64_t> terminated_rows;
+};
+
+// Parse one manifest line. Returns false if the layout is invalid.
+static bool ParseManifestLine(const string& line, ReplayFile* file) {
+  stringstream ss(line);
+  string layout;
+  ss >> file->path >> layout;
+  struct stat st;
+  if (stat(file->path.c_str(), &st) != 0) {
+    cerr << file->path << ": " << strerror(errno) << endl;
+    return false;
+  }
+  file->length = st.st_size;
+  file->indexed = stat((file->path + ".index").c_str(), &st) == 0;
+  vector<int64_t>& splits = file->split_offsets;
+  splits.push_back(0);
+  if (layout.compare(0, 5, "size=") == 0) {
+    int64_t split_size = atoll(layout.c_str() + 5);
+    if (split_size <= 0) {
+      cerr << "Invalid split size: '" << layout << "' for " << file->path << endl;
+      return false;
+    }
+    for (int64_t offset = split_size; offset < file->length; offset += split_size) {
+      splits.push_back(offset);
+    }
+  } else if (layout.compare(0, 8, "offsets=") == 0) {
+    stringstream offsets(layout.substr(8));
+    string offset;
+    while (getline(offsets, offset, ',')) {
+      int64_t value = atoll(offset.c_str());
+      if (value < 0 || value >= file->length) {
+        cerr << "Split offset " << value << " is outside of " << file->path << endl;
+        return false;
+      }
+      splits.push_back(value);
+    }
+    sort(splits.begin(), splits.end());
+    splits.erase(unique(splits.begin(), splits.end()), splits.end());
+  } else {
+    cerr << "Invalid split layout: '" << layout << "' for " << file->path << endl;
+    return false;
+  }
+  return true;
+}
+
+static bool RowMatches(const string& row) {
+  return row.find(FLAGS_replay_row_contains) != string::npos;
+}
+
+// Read the expected rows of 'file' with the reference reader.
+static bool ReadExpectedRows(ReplayFile* file) {
+  ReferenceReader reader(file->path, file->length);
+  string row, error;
+  bool terminated;
+  file->uncompressed_bytes = 0;
+  if (reader.Open(&error)) {
+    while (reader.Next(&row, &terminated, &error)) {
+      file->uncompressed_bytes += row.size() + terminated;
+      if (!RowMatches(row)) continue;
+      uint64_t hash = HdfsTextScanner::RowHash(row.data(), row.size());
+      file->rows.push_back(hash);
+      if (terminated) file->terminated_rows.push_back(hash);
+    }
+  }
+  if (!error.empty()) {
+    cerr << file->path << ": " << error << endl;
+    return false;
+  }
+  sort(file->rows.begin(), file->rows.end());
+  sort(file->terminated_rows.begin(), file->terminated_rows.end());
+  return true;
+}
+
+// Print up to MAX_PRINTED_ROWS rows of 'file' whose hash is in 'hashes'.
+static void PrintRows(const ReplayFile& file, const string& label,
+    const vector<uint64_t>& hashes) {
+  if (hashes.empty()) return;
+  set<uint64_t> wanted(hashes.begin(), hashes.end());
+  ReferenceReader reader(file.path, file.length);
+  string row, error;
+  bool terminated;
+  int printed = 0;
+  if (reader.Open(&error)) {
+    while (printed < MAX_PRINTED_ROWS && reader.Next(&row, &terminated, &error)) {
+      if (wanted.erase(HdfsTextScanner::RowHash(row.data(), row.size())) == 0) continue;
+      cout << "    " << label << ": '" << row.substr(0, 100)
+           << (row.size() > 100 ? "...'" : "'") << endl;
+      ++printed;
+    }
+  }
+  if (printed < hashes.size() && printed < MAX_PRINTED_ROWS) {
+    cout << "    " << label << ": " << hashes.size() - printed
+         << " row(s) not in the file" << endl;
+  }
+}
+
+// Compare the rows of a scan of 'file' with the expected ones. Returns false if
+// they do not match.
+static bool CheckRows(const ReplayFile& file, int pass, vector<uint64_t>* actual) {
+  sort(actual->begin(), actual->end());
+  bool sampled = FLAGS_lzo_sample_percent < 100;
+  bool incremental = !sampled && FLAGS_lzo_incremental_scan && file.indexed;
+  vector<uint64_t> empty;
+  const vector<uint64_t>& expected = !incremental ? file.rows :
+      (pass == 1 ? file.terminated_rows : empty);
+
+  vector<uint64_t> missing, extra;
+  set_difference(expected.begin(), expected.end(), actual->begin(), actual->end(),
+      back_inserter(missing));
+  set_difference(actual->begin(), actual->end(), expected.begin(), expected.end(),
+      back_inserter(extra));
+  // A sample may miss any row.
+  bool ok = extra.empty() && (sampled || missing.empty());
+  cout << "  " << file.path << ": " << (ok ? "OK" : "MISMATCH")
+       << " splits: " << file.split_offsets.size()
+       << " rows: " << actual->size() << "/" << expected.size();
+  if (sampled) cout << " (sampled)";
+  if (!sampled && !missing.empty()) cout << " missing: " << missing.size();
+  if (!extra.empty()) cout << " extra: " << extra.size();
+  cout << endl;
+  if (!ok) {
+    if (!sampled) PrintRows(file, "missing", missing);
+    PrintRows(file, "extra", extra);
+  }
+  return ok;
+}
+
+static string PrettyBytes(int64_t bytes) {
+  stringstream ss;
+  ss << fixed << setprecision(2) << bytes / (1024.0 * 1024.0) << " MB";
+  return ss.str();
+}
+
+// Scan all files once and check and report the result. Returns false if the scan
+// failed or returned the wrong rows.
+static bool ReplayPass(ExecEnv* exec_env, int pass, vector<ReplayFile>* files) {
+  TUniqueId fragment_instance_id;
+  fragment_instance_id.hi = getpid();
+  fragment_instance_id.lo = pass;
+  RuntimeState state(exec_env, fragment_instance_id, false);
+  HdfsPartitionDescriptor partition(0, TUPLE_DELIM, ',');
+  vector<Expr*> conjuncts;
+  vector<string> conjunct_literals;
+  if (!FLAGS_replay_row_contains.empty()) {
+    conjuncts.push_back(Expr::CreatePredicate(TExprOpcode::LIKE, new SlotRef(0),
+        Expr::CreateStringLiteral("%" + FLAGS_replay_row_contains + "%")));
+    conjunct_literals.push_back(FLAGS_replay_row_contains);
+  }
+  HdfsScanNode scan_node(&state, &partition, conjuncts, conjunct_literals);
+  int64_t compressed_bytes = 0;
+  int64_t uncompressed_bytes = 0;
+  for (int i = 0; i < files->size(); ++i) {
+    const ReplayFile& file = (*files)[i];
+    scan_node.AddFile(file.path, file.length, file.split_offsets);
+    compressed_bytes += file.length;
+    uncompressed_bytes += file.uncompressed_bytes;
+  }
+
+  int64_t hdfs_bytes_read = HdfsBytesRead();
+  MonotonicStopWatch watch;
+  watch.Start();
+  Status status = scan_node.Scan(FLAGS_replay_threads);
+  watch.Stop();
+  hdfs_bytes_read = HdfsBytesRead() - hdfs_bytes_read;
+
+  cout << "Pass " << pass << ":" << endl;
+  bool ok = status.ok();
+  if (!ok) cout << "  Scan failed: " << status.GetErrorMsg() << endl;
+  for (int i = 0; i < files->size(); ++i) {
+    ReplayFile& file = (*files)[i];
+    ok &= CheckRows(file, pass, &scan_node.rows()[file.path]);
+  }
+  vector<string> errors = state.errors();
+  for (int i = 0; i < errors.size(); ++i) cout << "  Logged error: " << errors[i] << endl;
+
+  double seconds = watch.ElapsedTime() / 1e9;
+  double mb = 1024.0 * 1024.0;
+  cout << fixed << setprecision(2)
+       << "  Time: " << seconds * 1000 << " ms, " << scan_node.num_ranges_scanned()
+       << " scan ranges, " << FLAGS_replay_threads << " threads" << endl
+       << "  Throughput: " << compressed_bytes / mb / seconds << " MB/s compressed, "
+       << uncompressed_bytes / mb / seconds << " MB/s uncompressed" << endl
+       << "  Bytes read: " << PrettyBytes(scan_node.bytes_read()) << " by scan ranges, "
+       << PrettyBytes(hdfs_bytes_read) << " by headers and indexes, of "
+       << PrettyBytes(compressed_bytes) << endl
+       << "  Peak memory: " << PrettyBytes(state.query_mem_limit()->peak_consumption())
+       << " query, " << PrettyBytes(scan_node.peak_io_buffer_bytes())
+       << " I/O buffers, " << PrettyBytes(exec_env->mem_limit()->consumption())
+       << " process after the scan (index cache)" << endl;
+
+  const map<string, RuntimeProfile::Counter*>& counters =
+      scan_node.runtime_profile()->counters();
+  cout << "  Counters:" << endl;
+  for (map<string, RuntimeProfile::Counter*>::const_iterator it = counters.begin();
+       it != counters.end(); ++it) {
+    cout << "    " << it->first << ": " << it->second->value() << endl;
+  }
+  return ok;
+}
+
+int main(int argc, char** argv) {
+  google::SetUsageMessage("Replay scans of local lzop files through the LZO scanner.\n"
+      "Usage: lzo-scan-replay [flags] <manifest>");
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  google::InitGoogleLogging(argv[0]);
+  if (argc != 2) {
+    cerr << "Usage: " << argv[0] << " [flags] <manifest>" << endl;
+    return 2;
+  }
+  if (lzo_init() != LZO_E_OK) {
+    cerr << "lzo_init() failed" << endl;
+    return 2;
+  }
+  ifstream manifest(argv[1]);
+  if (!manifest) {
+    cerr << "Could not open manifest: " << argv[1] << endl;
+    return 2;
+  }
+
+  vector<ReplayFile> files;
+  set<string> paths;
+  string line;
+  while (getline(manifest, line)) {
+    if (line.empty() || line[0] == '#') continue;
+    ReplayFile file;
+    if (!ParseManifestLine(line, &file) || !ReadExpectedRows(&file)) return 2;
+    // The scan node knows files by name.
+    if (!paths.insert(file.path).second) {
+      cerr << file.path << " is listed more than once in the manifest" << endl;
+      return 2;
+    }
+    files.push_back(file);
+  }
+
+  // As in impalad, the ExecEnv is never destroyed: the index cache keeps using its
+  // memory limit until the process exits.
+  ExecEnv* exec_env = new ExecEnv();
+  bool all_ok = true;
+  for (int pass = 1; pass <= FLAGS_replay_passes; ++pass) {
+    all_ok &= ReplayPass(exec_env, pass, &files);
+  }
+
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  cout << "Peak process memory: "
+       << PrettyBytes(exec_env->mem_limit()->peak_consumption())
+       << " charged to the process limit, max RSS "
+       << PrettyBytes(usage.ru_maxrss * 1024L) << endl;
+  map<string, string> metrics = exec_env->metrics()->GetValues();
+  cout << "Metrics:" << endl;
+  for (map<string, string>::iterator it = metrics.begin(); it != metrics.end(); ++it) {
+    cout << "  " << it->first << ": " << it->second << endl;
+  }
+  return all_ok ? 0 : 1;
+}
@@ -0,0 +1,589 @@
+// Copyright (c) 2012 Cloudera, Inc. All rights reserved.
+
+// Stand-ins for the scan node, the scanner context and the text scanner that run
+// the LZO scanner in the replay.
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <limits>
+#include <sstream>
+#include <boost/bind.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/thread.hpp>
+#include "exec/hdfs-scan-node.h"
+#include "exec/hdfs-text-scanner.h"
+#include "exec/scanner-context.h"
+#include "exprs/expr.h"
+#include "runtime/runtime-state.h"
+
+using namespace boost;
+using namespace impala;
+using namespace std;
+
+DEFINE_int32(replay_io_buffer_size, 8 * 1024 * 1024,
+    "Size of the buffers scan ranges are read in, the DiskIoMgr's maximum buffer size.");
+DEFINE_bool(replay_compact_data, false,
+    "Scan as if the query had no string slots, so that the scanners may reuse their "
+    "buffers for the next block instead of handing them to the row batch.");
+
+// Entry points of the LZO plugin. impalad looks them up with dlsym() and calls the
+// scanner through the base class.
+extern "C" HdfsTextScanner* CreateLzoTextScanner(
+    HdfsScanNode* scan_node, RuntimeState* state);
+extern "C" Status IssueInitialRanges(
+    HdfsScanNode* scan_node, const vector<HdfsFileDesc*>& files);
+
+namespace impala {
+
+ScannerContext::Stream::Stream(ScannerContext* parent,
+    DiskIoMgr::ScanRange* scan_range, int64_t file_length)
+  : parent_(parent),
+    scan_range_(scan_range),
+    scan_range_end_(scan_range->offset() + scan_range->len()),
+    file_length_(file_length),
+    fd_(open(scan_range->file(), O_RDONLY)),
+    file_offset_(scan_range->offset()),
+    read_offset_(scan_range->offset()),
+    boundary_buffer_(NULL),
+    boundary_buffer_len_(0),
+    read_past_buffer_size_(DEFAULT_READ_PAST_SIZE),
+    bytes_read_(0) {
+}
+
+bool ScannerContext::Stream::compact_data() const {
+  return FLAGS_replay_compact_data;
+}
+
+Status ScannerContext::Stream::ReadBuffers(int64_t end) {
+  if (fd_ == -1) {
+    stringstream ss;
+    ss << "Error opening file: " << filename() << ": " << strerror(errno);
+    return Status(ss.str());
+  }
+  end = min(end, file_length_);
+  while (read_offset_ < end) {
+    int64_t len = read_offset_ < scan_range_end_ ?
+        min<int64_t>(FLAGS_replay_io_buffer_size, scan_range_end_ - read_offset_) :
+        read_past_buffer_size_;
+    len = min(len, file_length_ - read_offset_);
+    Buffer buffer;
+    buffer.offset = read_offset_;
+    buffer.len = len;
+    buffer.data = reinterpret_cast<uint8_t*>(malloc(len));
+    parent_->scan_node_->UpdateIoBufferBytes(len);
+    MemLimit::UpdateLimits(len, parent_->state_->mem_limits());
+    for (int64_t num_read = 0; num_read < len;) {
+      ssize_t n = pread(fd_, buffer.data + num_read, len - num_read,
+          read_offset_ + num_read);
+      if (n <= 0) {
+        FreeBuffer(buffer.data, len);
+        stringstream ss;
+        ss << "Error reading " << filename() << " at offset " << read_offset_ + num_read;
+        return Status(ss.str());
+      }
+      num_read += n;
+    }
+    bytes_read_ += len;
+    read_offset_ += len;
+    // The scanner skipped these bytes.
+    if (buffer.offset + buffer.len <= file_offset_) {
+      FreeBuffer(buffer.data, buffer.len);
+    } else {
+      buffers_.push_back(buffer);
+    }
+  }
+  return Status::OK;
+}
+
+void ScannerContext::Stream::FreeBuffer(uint8_t* data, int64_t len) {
+  free(data);
+  parent_->scan_node_->UpdateIoBufferBytes(-len);
+  MemLimit::UpdateLimits(-len, parent_->state_->mem_limits());
+}
+
+void ScannerContext::Stream::ReleaseBuffers() {
+  if (boundary_buffer_ != NULL) {
+    FreeBuffer(boundary_buffer_, boundary_buffer_len_);
+    boundary_buffer_ = NULL;
+    boundary_buffer_len_ = 0;
+  }
+  while (!buffers_.empty() &&
+      buffers_.front().offset + buffers_.front().len <= file_offset_) {
+    FreeBuffer(buffers_.front().data, buffers_.front().len);
+    buffers_.pop_front();
+  }
+}
+
+bool ScannerContext::Stream::GetBytes(int requested_len, uint8_t** buffer,
+    int* out_len, bool* eos, Status* status) {
+  ReleaseBuffers();
+  *buffer = NULL;
+  *out_len = 0;
+  int64_t len = max<int64_t>(0, min<int64_t>(requested_len, file_length_ - file_offset_));
+  if (len > 0) {
+    *status = ReadBuffers(file_offset_ + len);
+    if (!status->ok()) {
+      *eos = true;
+      return false;
+    }
+    const Buffer& first = buffers_.front();
+    DCHECK_LE(first.offset, file_offset_);
+    if (file_offset_ + len <= first.offset + first.len) {
+      *buffer = first.data + (file_offset_ - first.offset);
+    } else {
+      // Copy the bytes from the buffers they span.
+      boundary_buffer_ = reinterpret_cast<uint8_t*>(malloc(len));
+      boundary_buffer_len_ = len;
+      parent_->scan_node_->UpdateIoBufferBytes(len);
+      MemLimit::UpdateLimits(len, parent_->state_->mem_limits());
+      int64_t copied = 0;
+      for (int i = 0; copied < len; ++i) {
+        const Buffer& b = buffers_[i];
+        int64_t start = file_offset_ + copied - b.offset;
+        int64_t n = min(len - copied, b.len - start);
+        memcpy(boundary_buffer_ + copied, b.data + start, n);
+        copied += n;
+      }
+      *buffer = boundary_buffer_;
+    }
+    file_offset_ += len;
+    *out_len = len;
+  }
+  *eos = eosr();
+  return true;
+}
+
+bool ScannerContext::Stream::ReadInt(int32_t* val, Status* status) {
+  uint8_t* bytes;
+  int len;
+  bool eos;
+  if (!GetBytes(sizeof(int32_t), &bytes, &len, &eos, status)) return false;
+  if (len != sizeof(int32_t)) {
+    stringstream ss;
+    ss << "Unexpected end of file: " << filename() << " at offset " << file_offset_;
+    *status = Status(ss.str());
+    return false;
+  }
+  *val = ReadWriteUtil::GetInt<uint32_t>(bytes);
+  return true;
+}
+
+bool ScannerContext::Stream::SkipBytes(int64_t length, Status* status) {
+  if (length > file_length_ - file_offset_) {
+    stringstream ss;
+    ss << "Cannot skip " << length << " bytes of " << filename() << " at offset "
+       << file_offset_ << ", past the end of the file";
+    *status = Status(ss.str());
+    return false;
+  }
+  file_offset_ += length;
+  return true;
+}
+
+ScannerContext::ScannerContext(RuntimeState* state, HdfsScanNode* scan_node,
+    HdfsPartitionDescriptor* partition_desc, DiskIoMgr::ScanRange* scan_range)
+  : state_(state),
+    scan_node_(scan_node),
+    partition_desc_(partition_desc),
+    stream_(this, scan_range, scan_node->GetFileDesc(scan_range->file())->file_length),
+    closed_(false) {
+}
+
+ScannerContext::~ScannerContext() {
+  Close();
+}
+
+bool ScannerContext::cancelled() const {
+  return scan_node_->done();
+}
+
+void ScannerContext::Close() {
+  if (closed_) return;
+  closed_ = true;
+  stream_.file_offset_ = numeric_limits<int64_t>::max();
+  stream_.ReleaseBuffers();
+  if (stream_.fd_ != -1) close(stream_.fd_);
+  scan_node_->AddBytesRead(stream_.bytes_read_);
+}
+
+HdfsScanNode::HdfsScanNode(RuntimeState* state, HdfsPartitionDescriptor* partition_desc,
+    const vector<Expr*>& conjuncts, const vector<string>& conjunct_literals)
+  : state_(state),
+    partition_desc_(partition_desc),
+    conjuncts_(conjuncts),
+    conjunct_literals_(conjunct_literals),
+    num_splits_(0),
+    num_running_ranges_(0),
+    num_splits_complete_(0),
+    num_ranges_scanned_(0),
+    num_ranges_dropped_(0),
+    done_(false),
+    bytes_read_(0),
+    io_buffer_bytes_(0),
+    peak_io_buffer_bytes_(0) {
+  memory_used_counter_ =
+      runtime_profile_.AddCounter("MemoryUsed", TCounterType::BYTES);
+}
+
+HdfsScanNode::~HdfsScanNode() {
+  for (int i = 0; i < files_.size(); ++i) delete files_[i];
+  for (int i = 0; i < conjuncts_.size(); ++i) delete conjuncts_[i];
+}
+
+void HdfsScanNode::AddFile(const string& filename, int64_t file_length,
+    const vector<int64_t>& split_offsets) {
+  HdfsFileDesc* file_desc = new HdfsFileDesc(filename);
+  file_desc->file_length = file_length;
+  for (int i = 0; i < split_offsets.size(); ++i) {
+    int64_t end = i + 1 < split_offsets.size() ? split_offsets[i + 1] : file_length;
+    file_desc->splits.push_back(AllocateScanRange(filename.c_str(),
+        end - split_offsets[i], split_offsets[i], partition_desc_->id(), 0));
+  }
+  files_.push_back(file_desc);
+  file_descs_[filename] = file_desc;
+  num_splits_ += split_offsets.size();
+}
+
+Status HdfsScanNode::Scan(int num_threads) {
+  done_ = num_splits_ == 0;
+  RETURN_IF_ERROR(IssueInitialRanges(this, files_));
+  thread_group threads;
+  for (int i = 0; i < num_threads; ++i) {
+    threads.create_thread(bind(&HdfsScanNode::ScannerThread, this));
+  }
+  threads.join_all();
+
+  lock_guard<mutex> l(lock_);
+  RETURN_IF_ERROR(status_);
+  if (num_ranges_dropped_ > 0) {
+    stringstream ss;
+    ss << num_ranges_dropped_ << " scan range(s) were still queued when all splits "
+       << "had been reported complete. Their rows were not returned.";
+    return Status(ss.str());
+  }
+  if (!done_) {
+    stringstream ss;
+    ss << "Only " << num_splits_complete_ << " of " << num_splits_ << " splits were "
+       << "reported complete when no scan ranges were left. An impalad would not "
+       << "finish the scan.";
+    return Status(ss.str());
+  }
+  return Status::OK;
+}
+
+void HdfsScanNode::ScannerThread() {
+  while (true) {
+    DiskIoMgr::ScanRange* range;
+    {
+      unique_lock<mutex> l(lock_);
+      while (queued_ranges_.empty() && num_running_ranges_ > 0 && !done_ &&
+          status_.ok()) {
+        ranges_cv_.wait(l);
+      }
+      if (done_ || !status_.ok() || queued_ranges_.empty()) {
+        if (done_) {
+          num_ranges_dropped_ += queued_ranges_.size();
+          queued_ranges_.clear();
+        }
+        ranges_cv_.notify_all();
+        return;
+      }
+      range = queued_ranges_.front();
+      queued_ranges_.pop_front();
+      ++num_running_ranges_;
+    }
+    Status status = ProcessRange(range);
+    {
+      lock_guard<mutex> l(lock_);
+      --num_running_ranges_;
+      ++num_ranges_scanned_;
+      if (!status.ok() && status_.ok()) status_ = status;
+    }
+    ranges_cv_.notify_all();
+  }
+}
+
+Status HdfsScanNode::ProcessRange(DiskIoMgr::ScanRange* range) {
+  ScannerContext context(state_, this, partition_desc_, range);
+  scoped_ptr<HdfsTextScanner> scanner(CreateLzoTextScanner(this, state_));
+  Status status = scanner->Prepare(&context);
+  if (status.ok()) status = scanner->ProcessSplit();
+  // Scanners are closed after errors as well.
+  Status close_status = scanner->Close();
+  return status.ok() ? close_status : status;
+}
+
+bool HdfsScanNode::done() {
+  lock_guard<mutex> l(lock_);
+  return done_;
+}
+
+void* HdfsScanNode::GetFileMetadata(const string& filename) {
+  lock_guard<mutex> l(lock_);
+  map<string, void*>::iterator it = file_metadata_.find(filename);
+  return it == file_metadata_.end() ? NULL : it->second;
+}
+
+void HdfsScanNode::SetFileMetadata(const string& filename, void* metadata) {
+  lock_guard<mutex> l(lock_);
+  file_metadata_[filename] = metadata;
+}
+
+HdfsFileDesc* HdfsScanNode::GetFileDesc(const string& filename) {
+  map<string, HdfsFileDesc*>::iterator it = file_descs_.find(filename);
+  DCHECK(it != file_descs_.end());
+  return it->second;
+}
+
+DiskIoMgr::ScanRange* HdfsScanNode::AllocateScanRange(const char* file, int64_t len,
+    int64_t offset, int64_t partition_id, int disk_id) {
+  ScanRangeMetadata* metadata =
+      state_->obj_pool()->Add(new ScanRangeMetadata(partition_id));
+  return state_->obj_pool()->Add(
+      new DiskIoMgr::ScanRange(file, len, offset, disk_id, metadata));
+}
+
+Status HdfsScanNode::AddDiskIoRanges(const vector<DiskIoMgr::ScanRange*>& ranges) {
+  {
+    lock_guard<mutex> l(lock_);
+    queued_ranges_.insert(queued_ranges_.end(), ranges.begin(), ranges.end());
+  }
+  ranges_cv_.notify_all();
+  return Status::OK;
+}
+
+Status HdfsScanNode::AddDiskIoRanges(const HdfsFileDesc* file_desc) {
+  return AddDiskIoRanges(file_desc->splits);
+}
+
+void HdfsScanNode::RangeComplete(THdfsFileFormat::type file_type,
+    THdfsCompression::type compression_type) {
+  {
+    lock_guard<mutex> l(lock_);
+    if (num_splits_complete_ == num_splits_) {
+      if (status_.ok()) {
+        status_ = Status("RangeComplete() was called more often than there are splits");
+      }
+      return;
+    }
+    done_ = ++num_splits_complete_ == num_splits_;
+  }
+  ranges_cv_.notify_all();
+}
+
+bool HdfsScanNode::EvalConjuncts(const char* row, int len) const {
+  for (int i = 0; i < conjunct_literals_.size(); ++i) {
+    const string& literal = conjunct_literals_[i];
+    if (memmem(row, len, literal.data(), literal.size()) == NULL) return false;
+  }
+  return true;
+}
+
+void HdfsScanNode::AddRows(const string& filename, const vector<uint64_t>& hashes) {
+  lock_guard<mutex> l(lock_);
+  vector<uint64_t>& rows = rows_[filename];
+  rows.insert(rows.end(), hashes.begin(), hashes.end());
+}
+
+void HdfsScanNode::AddBytesRead(int64_t bytes) {
+  __sync_fetch_and_add(&bytes_read_, bytes);
+}
+
+void HdfsScanNode::UpdateIoBufferBytes(int64_t bytes) {
+  int64_t current = __sync_add_and_fetch(&io_buffer_bytes_, bytes);
+  int64_t peak = peak_io_buffer_bytes_;
+  while (current > peak &&
+      !__sync_bool_compare_and_swap(&peak_io_buffer_bytes_, peak, current)) {
+    peak = peak_io_buffer_bytes_;
+  }
+}
+
+HdfsTextScanner::HdfsTextScanner(HdfsScanNode* scan_node, RuntimeState* state)
+  : scan_node_(scan_node),
+    state_(state),
+    context_(NULL),
+    stream_(NULL),
+    byte_buffer_ptr_(NULL),
+    byte_buffer_end_(NULL),
+    byte_buffer_read_size_(0),
+    codegen_fn_(NULL),
+    tuple_delim_('\n') {
+}
+
+HdfsTextScanner::~HdfsTextScanner() {
+}
+
+Status HdfsTextScanner::Prepare(ScannerContext* context) {
+  context_ = context;
+  stream_ = context->GetStream();
+  return Status::OK;
+}
+
+Status HdfsTextScanner::ProcessSplit() {
+  tuple_delim_ = context_->partition_descriptor()->line_delim();
+  partial_tuple_.clear();
+  byte_buffer_ptr_ = byte_buffer_end_ = NULL;
+  byte_buffer_read_size_ = 0;
+  stream_->set_read_past_buffer_size(NEXT_BLOCK_READ_SIZE);
+
+  bool tuple_found;
+  RETURN_IF_ERROR(FindFirstTuple(&tuple_found));
+  if (tuple_found) {
+    int num_tuples;
+    RETURN_IF_ERROR(ProcessRange(&num_tuples, false));
+    RETURN_IF_ERROR(FinishScanRange());
+  }
+  return Status::OK;
+}
+
+Status HdfsTextScanner::Close() {
+  AddFinalRowBatch();
+  context_->Close();
+  scan_node_->RangeComplete(THdfsFileFormat::TEXT, THdfsCompression::NONE);
+  return Status::OK;
+}
+
+Status HdfsTextScanner::FindFirstTuple(bool* tuple_found) {
+  *tuple_found = true;
+  if (stream_->scan_range()->offset() == 0) return Status::OK;
+  *tuple_found = false;
+  while (true) {
+    bool eosr = false;
+    RETURN_IF_ERROR(FillByteBuffer(&eosr));
+    if (byte_buffer_read_size_ > 0) {
+      char* delim = reinterpret_cast<char*>(
+          memchr(byte_buffer_ptr_, tuple_delim_, byte_buffer_read_size_));
+      if (delim != NULL) {
+        byte_buffer_ptr_ = delim + 1;
+        *tuple_found = true;
+        return Status::OK;
+      }
+    }
+    byte_buffer_ptr_ = byte_buffer_end_;
+    if (eosr) return Status::OK;
+  }
+}
+
+Status HdfsTextScanner::ProcessRange(int* num_tuples, bool past_scan_range) {
+  bool eosr = past_scan_range || stream_->eosr();
+  *num_tuples = 0;
+  while (true) {
+    if (!eosr && byte_buffer_ptr_ == byte_buffer_end_) {
+      int64_t offset = stream_->file_offset();
+      RETURN_IF_ERROR(FillByteBuffer(&eosr));
+      if (byte_buffer_read_size_ == 0 && !eosr && stream_->file_offset() == offset) {
+        stringstream ss;
+        ss << "FillByteBuffer() returned no data and no eosr for "
+           << stream_->filename() << " at offset " << offset;
+        return Status(ss.str());
+      }
+    }
+    *num_tuples +=
+        ParseTuples(past_scan_range ? 1 : numeric_limits<int>::max());
+    if (past_scan_range) break;
+    if (byte_buffer_ptr_ == byte_buffer_end_ && eosr) break;
+    if (scan_node_->ReachedLimit() || context_->cancelled()) break;
+  }
+  return Status::OK;
+}
+
+Status HdfsTextScanner::FinishScanRange() {
+  if (scan_node_->ReachedLimit() || context_->cancelled()) return Status::OK;
+  while (true) {
+    bool eosr = true;
+    byte_buffer_read_size_ = 0;
+    Status status = FillByteBuffer(&eosr, NEXT_BLOCK_READ_SIZE);
+    if (!status.ok() || byte_buffer_read_size_ == 0) {
+      if (!status.ok()) {
+        if (state_->LogHasSpace()) state_->LogError(status.GetErrorMsg());
+        if (state_->abort_on_error()) return status;
+      } else if (!partial_tuple_.empty()) {
+        // There is nothing after the partial tuple, e.g. at the end of a file
+        // without a final delimiter.
+        AddRow(partial_tuple_.data(), partial_tuple_.size());
+        partial_tuple_.clear();
+      }
+      break;
+    }
+    int num_tuples;
+    RETURN_IF_ERROR(ProcessRange(&num_tuples, true));
+    if (num_tuples == 1) break;
+  }
+  return Status::OK;
+}
+
+int HdfsTextScanner::ParseTuples(int max_tuples) {
+  int num_tuples = 0;
+  while (num_tuples < max_tuples && byte_buffer_ptr_ < byte_buffer_end_) {
+    char* delim = reinterpret_cast<char*>(
+        memchr(byte_buffer_ptr_, tuple_delim_, byte_buffer_end_ - byte_buffer_ptr_));
+    if (delim == NULL) {
+      partial_tuple_.append(byte_buffer_ptr_, byte_buffer_end_ - byte_buffer_ptr_);
+      byte_buffer_ptr_ = byte_buffer_end_;
+      break;
+    }
+    if (partial_tuple_.empty()) {
+      AddRow(byte_buffer_ptr_, delim - byte_buffer_ptr_);
+    } else {
+      partial_tuple_.append(byte_buffer_ptr_, delim - byte_buffer_ptr_);
+      AddRow(partial_tuple_.data(), partial_tuple_.size());
+      partial_tuple_.clear();
+    }
+    byte_buffer_ptr_ = delim + 1;
+    ++num_tuples;
+  }
+  return num_tuples;
+}
+
+void HdfsTextScanner::AddRow(const char* data, int len) {
+  if (!scan_node_->EvalConjuncts(data, len)) return;
+  row_hashes_.push_back(RowHash(data, len));
+}
+
+void HdfsTextScanner::ResetScanner() {
+  partial_tuple_.clear();
+}
+
+void HdfsTextScanner::AttachPool(MemPool* pool) {
+  pool->FreeAll();
+}
+
+void HdfsTextScanner::AddFinalRowBatch() {
+  if (row_hashes_.empty()) return;
+  scan_node_->AddRows(stream_->filename(), row_hashes_);
+  row_hashes_.clear();
+}
+
+uint64_t HdfsTextScanner::RowHash(const char* data, int len) {
+  // MurmurHash64A.
+  const uint64_t m = 0xc6a4a7935bd1e995ULL;
+  const int r = 47;
+  uint64_t h = 0x8445d61a4e774912ULL ^ (len * m);
+  const char* end = data + (len & ~7);
+  for (const char* p = data; p != end; p += 8) {
+    uint64_t k;
+    memcpy(&k, p, sizeof(k));
+    k *= m;
+    k ^= k >> r;
+    k *= m;
+    h ^= k;
+    h *= m;
+  }
+  if (len & 7) {
+    uint64_t k = 0;
+    for (int i = (len & 7) - 1; i >= 0; --i) {
+      k = (k << 8) | static_cast<uint8_t>(end[i]);
+    }
+    h ^= k;
+    h *= m;
+  }
+  h ^= h >> r;
+  h *= m;
+  h ^= h >> r;
+  return h;
+}
+
+}
@@ -0,0 +1,64 @@
+// Copyright (c) 2012 Cloudera, Inc. All rights reserved.
+
+// libhdfs on the local file system, for the index and block header reads of the
+// LZO scanner.
+
+#include <hdfs.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+struct hdfsFile_internal {
+  int fd;
+};
+
+static int64_t bytes_read = 0;
+
+// Counts bytes read if num_read is not an error, and returns it.
+static tSize CountRead(ssize_t num_read) {
+  if (num_read > 0) __sync_fetch_and_add(&bytes_read, num_read);
+  return num_read;
+}
+
+int hdfsExists(hdfsFS fs, const char* path) {
+  struct stat st;
+  return stat(path, &st) == 0 ? 0 : -1;
+}
+
+hdfsFile hdfsOpenFile(hdfsFS fs, const char* path, int flags, int buffer_size,
+    short replication, tSize block_size) {
+  if ((flags & O_ACCMODE) != O_RDONLY) {
+    errno = EINVAL;
+    return NULL;
+  }
+  int fd = open(path, O_RDONLY);
+  if (fd == -1) return NULL;
+  hdfsFile file = new hdfsFile_internal();
+  file->fd = fd;
+  return file;
+}
+
+int hdfsCloseFile(hdfsFS fs, hdfsFile file) {
+  int ret = close(file->fd);
+  delete file;
+  return ret;
+}
+
+tSize hdfsRead(hdfsFS fs, hdfsFile file, void* buffer, tSize length) {
+  return CountRead(read(file->fd, buffer, length));
+}
+
+tSize hdfsPread(hdfsFS fs, hdfsFile file, tOffset position, void* buffer,
+    tSize length) {
+  return CountRead(pread(file->fd, buffer, length, position));
+}
+
+namespace impala {
+
+int64_t HdfsBytesRead() {
+  return bytes_read;
+}
+
+}
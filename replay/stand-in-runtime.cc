@@ -0,0 +1,194 @@
+// Copyright (c) 2012 Cloudera, Inc. All rights reserved.
+
+// Stand-ins for the Impala runtime and utility classes used by the LZO scanner.
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <iomanip>
+#include <sstream>
+#include <boost/thread/locks.hpp>
+#include "common/status.h"
+#include "exec/read-write-util.h"
+#include "exprs/expr.h"
+#include "runtime/descriptors.h"
+#include "runtime/mem-limit.h"
+#include "runtime/mem-pool.h"
+#include "runtime/runtime-state.h"
+#include "util/debug-util.h"
+#include "util/hdfs-util.h"
+#include "util/runtime-profile.h"
+
+using namespace boost;
+using namespace impala;
+using namespace std;
+
+namespace impala {
+
+const Status Status::OK;
+
+string Status::GetErrorMsg() const {
+  string msg;
+  for (int i = 0; i < error_msgs_.size(); ++i) {
+    if (i > 0) msg += "\n";
+    msg += error_msgs_[i];
+  }
+  return msg;
+}
+
+void MemLimit::Consume(int64_t bytes) {
+  int64_t consumption = __sync_add_and_fetch(&consumption_, bytes);
+  int64_t peak = peak_consumption_;
+  while (consumption > peak &&
+      !__sync_bool_compare_and_swap(&peak_consumption_, peak, consumption)) {
+    peak = peak_consumption_;
+  }
+}
+
+void MemLimit::UpdateLimits(int64_t bytes, vector<MemLimit*>* limits) {
+  for (int i = 0; i < limits->size(); ++i) (*limits)[i]->Consume(bytes);
+}
+
+bool MemLimit::LimitExceeded(const vector<MemLimit*>& limits) {
+  for (int i = 0; i < limits.size(); ++i) {
+    if (limits[i]->LimitExceeded()) return true;
+  }
+  return false;
+}
+
+MemPool::MemPool(vector<MemLimit*>* limits)
+  : limits_(limits),
+    total_allocated_bytes_(0),
+    peak_allocated_bytes_(0) {
+}
+
+MemPool::~MemPool() {
+  FreeAll();
+}
+
+uint8_t* MemPool::Allocate(int size) {
+  uint8_t* chunk = reinterpret_cast<uint8_t*>(malloc(size == 0 ? 1 : size));
+  chunks_.push_back(chunk);
+  total_allocated_bytes_ += size;
+  peak_allocated_bytes_ = max(peak_allocated_bytes_, total_allocated_bytes_);
+  if (limits_ != NULL) MemLimit::UpdateLimits(size, limits_);
+  return chunk;
+}
+
+void MemPool::FreeAll() {
+  for (int i = 0; i < chunks_.size(); ++i) free(chunks_[i]);
+  chunks_.clear();
+  if (limits_ != NULL) MemLimit::UpdateLimits(-total_allocated_bytes_, limits_);
+  total_allocated_bytes_ = 0;
+}
+
+RuntimeProfile::~RuntimeProfile() {
+  for (map<string, Counter*>::iterator it = counters_.begin();
+       it != counters_.end(); ++it) {
+    delete it->second;
+  }
+}
+
+RuntimeProfile::Counter* RuntimeProfile::AddCounter(const string& name,
+    TCounterType::type type) {
+  lock_guard<mutex> l(lock_);
+  Counter*& counter = counters_[name];
+  if (counter == NULL) counter = new Counter(type);
+  return counter;
+}
+
+DescriptorTbl::~DescriptorTbl() {
+  for (int i = 0; i < slots_.size(); ++i) delete slots_[i];
+}
+
+SlotDescriptor* DescriptorTbl::GetSlotDescriptor(int id) const {
+  for (int i = 0; i < slots_.size(); ++i) {
+    if (slots_[i]->id() == id) return slots_[i];
+  }
+  return NULL;
+}
+
+RuntimeState::RuntimeState(ExecEnv* exec_env, const TUniqueId& fragment_instance_id,
+    bool abort_on_error)
+  : exec_env_(exec_env),
+    fragment_instance_id_(fragment_instance_id),
+    abort_on_error_(abort_on_error) {
+  // The table has one string column, the line, in slot 0.
+  vector<SlotDescriptor*> slots;
+  slots.push_back(new SlotDescriptor(0, TYPE_STRING, 0));
+  desc_tbl_.reset(new DescriptorTbl(slots));
+  mem_limits_.push_back(&query_mem_limit_);
+  mem_limits_.push_back(exec_env->mem_limit());
+}
+
+bool RuntimeState::LogHasSpace() {
+  lock_guard<mutex> l(error_lock_);
+  return errors_.size() < MAX_ERRORS;
+}
+
+void RuntimeState::LogError(const string& error) {
+  lock_guard<mutex> l(error_lock_);
+  if (errors_.size() < MAX_ERRORS) errors_.push_back(error);
+}
+
+vector<string> RuntimeState::errors() {
+  lock_guard<mutex> l(error_lock_);
+  return errors_;
+}
+
+string PrintId(const TUniqueId& id) {
+  stringstream ss;
+  ss << hex << id.hi << ":" << id.lo;
+  return ss.str();
+}
+
+string AppendHdfsErrorMessage(const string& prefix, const string& file) {
+  stringstream ss;
+  ss << prefix << file << "\nError(" << errno << "): " << strerror(errno);
+  return ss.str();
+}
+
+string ReadWriteUtil::HexDump(const uint8_t* buf, int len) {
+  stringstream ss;
+  ss << hex;
+  for (int i = 0; i < len; ++i) {
+    if (i > 0) ss << (i % 16 == 0 ? "\n" : " ");
+    ss << setw(2) << setfill('0') << static_cast<int>(buf[i]);
+  }
+  return ss.str();
+}
+
+// A constant string.
+class StringLiteral : public Expr {
+ public:
+  StringLiteral(const string& value)
+    : Expr(TExprOpcode::INVALID_OPCODE, true),
+      value_(value),
+      string_value_(const_cast<char*>(value_.data()), value_.size()) {
+  }
+
+  virtual void* GetValue(TupleRow* row) { return &string_value_; }
+
+ private:
+  string value_;
+  StringValue string_value_;
+};
+
+// A binary predicate.
+class Predicate : public Expr {
+ public:
+  Predicate(TExprOpcode::type op, Expr* lhs, Expr* rhs) : Expr(op, false) {
+    children_.push_back(lhs);
+    children_.push_back(rhs);
+  }
+};
+
+Expr* Expr::CreateStringLiteral(const string& value) {
+  return new StringLiteral(value);
+}
+
+Expr* Expr::CreatePredicate(TExprOpcode::type op, Expr* lhs, Expr* rhs) {
+  return new Predicate(op, lhs, rhs);
+}
+
+}
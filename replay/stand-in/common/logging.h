@@ -0,0 +1,17 @@
+// Copyright (c) 2012 Cloudera, Inc. All rights reserved.
+
+#ifndef IMPALA_COMMON_LOGGING_H
+#define IMPALA_COMMON_LOGGING_H
+
+// The verbose logging levels of impalad, on top of glog as in Impala.
+#include <glog/logging.h>
+#include <gflags/gflags.h>
+
+#define VLOG_QUERY VLOG(1)
+#define VLOG_FILE VLOG(2)
+#define VLOG_ROW VLOG(3)
+#define VLOG_QUERY_IS_ON VLOG_IS_ON(1)
+#define VLOG_FILE_IS_ON VLOG_IS_ON(2)
+#define VLOG_ROW_IS_ON VLOG_IS_ON(3)
+
+#endif
@@ -0,0 +1,46 @@
+// Copyright (c) 2012 Cloudera, Inc. All rights reserved.
+
+#ifndef IMPALA_COMMON_OBJECT_POOL_H
+#define IMPALA_COMMON_OBJECT_POOL_H
+
+#include <vector>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace impala {
+
+// Owns objects until the pool is destroyed, as Impala's ObjectPool.
+class ObjectPool {
+ public:
+  ObjectPool() { }
+
+  ~ObjectPool() {
+    for (int i = objects_.size() - 1; i >= 0; --i) delete objects_[i];
+  }
+
+  template <class T>
+  T* Add(T* t) {
+    boost::lock_guard<boost::mutex> l(lock_);
+    objects_.push_back(new SpecificElement<T>(t));
+    return t;
+  }
+
+ private:
+  struct GenericElement {
+    virtual ~GenericElement() { }
+  };
+
+  template <class T>
+  struct SpecificElement : GenericElement {
+    SpecificElement(T* t) : t(t) { }
+    ~SpecificElement() { delete t; }
+    T* t;
+  };
+
+  boost::mutex lock_;
+  std::vector<GenericElement*> objects_;
+};
+
+}
+
+#endif
@@ -0,0 +1,42 @@
+// Copyright (c) 2012 Cloudera, Inc. All rights reserved.
+
+#ifndef IMPALA_COMMON_STATUS_H
+#define IMPALA_COMMON_STATUS_H
+
+#include <string>
+#include <vector>
+#include "common/logging.h"
+
+namespace impala {
+
+// Stand-in for Impala's Status: OK or a list of error messages.
+class Status {
+ public:
+  static const Status OK;
+
+  Status() { }
+
+  Status(const std::string& error_msg) {
+    error_msgs_.push_back(error_msg);
+  }
+
+  bool ok() const { return error_msgs_.empty(); }
+
+  void AddErrorMsg(const std::string& msg) { error_msgs_.push_back(msg); }
+
+  // Returns the error messages separated by newlines.
+  std::string GetErrorMsg() const;
+
+ private:
+  std::vector<std::string> error_msgs_;
+};
+
+#define RETURN_IF_ERROR(stmt) \
+  do { \
+    Status __status__ = (stmt); \
+    if (!__status__.ok()) return __status__; \
+  } while (false)
+
+}
+
+#endif
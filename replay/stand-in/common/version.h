@@ -0,0 +1,8 @@
+// Copyright (c) 2012 Cloudera, Inc. All rights reserved.
+
+#ifndef IMPALA_COMMON_VERSION_H
+#define IMPALA_COMMON_VERSION_H
+
+#define IMPALA_BUILD_VERSION "lzo-scan-replay"
+
+#endif
@@ -0,0 +1,162 @@
+// Copyright (c) 2012 Cloudera, Inc. All rights reserved.
+
+#ifndef IMPALA_EXEC_HDFS_SCAN_NODE_H
+#define IMPALA_EXEC_HDFS_SCAN_NODE_H
+
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <hdfs.h>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include "common/status.h"
+#include "gen-cpp/Descriptors_types.h"
+#include "runtime/descriptors.h"
+#include "runtime/disk-io-mgr.h"
+#include "util/runtime-profile.h"
+
+namespace impala {
+
+class Expr;
+class RuntimeState;
+
+// Metadata attached to the scan ranges of a file.
+struct ScanRangeMetadata {
+  int64_t partition_id;
+
+  ScanRangeMetadata(int64_t partition_id) : partition_id(partition_id) { }
+};
+
+// A file and the splits of it assigned to this impalad.
+struct HdfsFileDesc {
+  HdfsFileDesc(const std::string& filename) : filename(filename), file_length(0) { }
+
+  std::string filename;
+  int64_t file_length;
+  std::vector<DiskIoMgr::ScanRange*> splits;
+};
+
+// Stand-in for the HdfsScanNode of one LZO table partition. It hands the files to
+// the plugin's IssueInitialRanges(), queues the ranges the plugin issues and runs
+// each of them with a new scanner from CreateLzoTextScanner() on a pool of scanner
+// threads, the way the Impala 1.x scan node does.
+//
+// As in Impala, the node is done once every initial split has been reported to
+// RangeComplete(). Ranges still queued at that point are not scanned and their
+// rows are lost, and scanners still running see a cancelled context. Scan() returns
+// an error if that happens, or if the queue runs dry while splits are still not
+// complete, where an impalad would hang.
+class HdfsScanNode {
+ public:
+  // The rows of the scan are evaluated against 'conjuncts', which the node owns.
+  // Only the text of the whole row is checked: rows must contain the literal of
+  // each LIKE '%<literal>%' or = '<literal>' conjunct.
+  HdfsScanNode(RuntimeState* state, HdfsPartitionDescriptor* partition_desc,
+      const std::vector<Expr*>& conjuncts,
+      const std::vector<std::string>& conjunct_literals);
+  ~HdfsScanNode();
+
+  // Add a file whose splits start at 'split_offsets' and end at the next split or
+  // the end of the file.
+  void AddFile(const std::string& filename, int64_t file_length,
+      const std::vector<int64_t>& split_offsets);
+
+  // Issue the initial ranges and scan until the node is done, with 'num_threads'
+  // scanner threads. Returns the first error of a scanner or of the node.
+  Status Scan(int num_threads);
+
+  // Hashes of the rows returned for each file.
+  std::map<std::string, std::vector<uint64_t> >& rows() { return rows_; }
+
+  // Number of scan ranges scanned, including the ranges of the file headers.
+  int num_ranges_scanned() const { return num_ranges_scanned_; }
+
+  // Bytes of the files read by the scanners' streams.
+  int64_t bytes_read() const { return bytes_read_; }
+
+  // Peak memory held by the I/O buffers of the streams.
+  int64_t peak_io_buffer_bytes() const { return peak_io_buffer_bytes_; }
+
+  // The rest of the interface is the part of HdfsScanNode the LZO scanner uses.
+  RuntimeProfile* runtime_profile() { return &runtime_profile_; }
+  RuntimeProfile::Counter* memory_used_counter() { return memory_used_counter_; }
+  hdfsFS hdfs_connection() { return NULL; }
+  const HdfsTableDescriptor* hdfs_table() { return &table_desc_; }
+  const std::vector<Expr*>& conjuncts() { return conjuncts_; }
+
+  // The replay does not apply a limit.
+  bool ReachedLimit() { return false; }
+
+  // Returns true once all splits have been reported complete.
+  bool done();
+
+  void* GetFileMetadata(const std::string& filename);
+  void SetFileMetadata(const std::string& filename, void* metadata);
+
+  HdfsFileDesc* GetFileDesc(const std::string& filename);
+
+  DiskIoMgr::ScanRange* AllocateScanRange(const char* file, int64_t len,
+      int64_t offset, int64_t partition_id, int disk_id);
+
+  Status AddDiskIoRanges(const std::vector<DiskIoMgr::ScanRange*>& ranges);
+  Status AddDiskIoRanges(const HdfsFileDesc* file_desc);
+
+  // Report one initial split complete.
+  void RangeComplete(THdfsFileFormat::type file_type,
+      THdfsCompression::type compression_type);
+
+  void ReleaseCodegenFn(THdfsFileFormat::type type, void* fn) { }
+
+  // Called by the stand-in text scanner with the rows of a scan range. Rows that do
+  // not contain all conjunct literals are dropped here.
+  bool EvalConjuncts(const char* row, int len) const;
+  void AddRows(const std::string& filename, const std::vector<uint64_t>& hashes);
+
+  // Called by the stand-in stream.
+  void AddBytesRead(int64_t bytes);
+  void UpdateIoBufferBytes(int64_t bytes);
+
+ private:
+  // Loop of a scanner thread.
+  void ScannerThread();
+
+  // Scan one range with a new scanner.
+  Status ProcessRange(DiskIoMgr::ScanRange* range);
+
+  RuntimeState* state_;
+  HdfsPartitionDescriptor* partition_desc_;
+  HdfsTableDescriptor table_desc_;
+  std::vector<Expr*> conjuncts_;
+  std::vector<std::string> conjunct_literals_;
+  RuntimeProfile runtime_profile_;
+  RuntimeProfile::Counter* memory_used_counter_;
+
+  std::vector<HdfsFileDesc*> files_;
+  std::map<std::string, HdfsFileDesc*> file_descs_;
+  int num_splits_;
+
+  // Protects everything below.
+  boost::mutex lock_;
+  boost::condition_variable ranges_cv_;
+
+  std::map<std::string, void*> file_metadata_;
+  std::deque<DiskIoMgr::ScanRange*> queued_ranges_;
+  int num_running_ranges_;
+  int num_splits_complete_;
+  int num_ranges_scanned_;
+  // Ranges that were still queued when the node was done.
+  int num_ranges_dropped_;
+  bool done_;
+  Status status_;
+
+  std::map<std::string, std::vector<uint64_t> > rows_;
+  int64_t bytes_read_;
+  int64_t io_buffer_bytes_;
+  int64_t peak_io_buffer_bytes_;
+};
+
+}
+
+#endif
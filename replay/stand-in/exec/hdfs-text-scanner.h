@@ -0,0 +1,112 @@
+// Copyright (c) 2012 Cloudera, Inc. All rights reserved.
+
+#ifndef IMPALA_EXEC_HDFS_TEXT_SCANNER_H
+#define IMPALA_EXEC_HDFS_TEXT_SCANNER_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <boost/scoped_ptr.hpp>
+#include "common/status.h"
+#include "exec/hdfs-scan-node.h"
+#include "exec/read-write-util.h"
+#include "exec/scanner-context.h"
+#include "runtime/disk-io-mgr.h"
+#include "runtime/mem-pool.h"
+#include "util/runtime-profile.h"
+
+namespace impala {
+
+class HdfsScanNode;
+class RuntimeState;
+
+// Stand-in for the text scanner the LZO scanner derives from. It drives
+// FillByteBuffer() the way the Impala 1.x HdfsTextScanner does:
+//  - a range that does not start at offset 0 skips the bytes up to the first line
+//    delimiter, which belong to the last record of the previous range
+//    (FindFirstTuple)
+//  - the rest of the range is read with FillByteBuffer(&eosr) until it returns
+//    eosr (ProcessRange)
+//  - the last record is finished with FillByteBuffer(&eosr, NEXT_BLOCK_READ_SIZE)
+//    reads until one more tuple is complete or no bytes are returned
+//    (FinishScanRange). If no bytes are returned, e.g. at the end of the file, the
+//    partial record is a row.
+// Rows are whole lines. Instead of materializing tuples, the scanner hashes the
+// rows that pass the scan node's conjuncts and hands the hashes to the node.
+class HdfsTextScanner {
+ public:
+  HdfsTextScanner(HdfsScanNode* scan_node, RuntimeState* state);
+  virtual ~HdfsTextScanner();
+
+  // Set up the scanner for the scan range of 'context'.
+  virtual Status Prepare(ScannerContext* context);
+
+  virtual Status ProcessSplit();
+  virtual Status Close();
+
+  // Hash of a row, as compared by the replay.
+  static uint64_t RowHash(const char* data, int len);
+
+ protected:
+  // Size of the reads past the end of the scan range.
+  static const int NEXT_BLOCK_READ_SIZE = 1024;
+
+  // Set byte_buffer_ptr_ and byte_buffer_read_size_ to the next num_bytes bytes,
+  // or to the next buffer of data if num_bytes is 0. *eosr is set if there is no
+  // data in the scan range after these bytes.
+  virtual Status FillByteBuffer(bool* eosr, int num_bytes = 0) = 0;
+
+  // Drop the partial tuple, after data was skipped.
+  void ResetScanner();
+
+  // Hand the memory of 'pool' to the row batch. The rows of the stand-in do not
+  // point into it, so it is freed, as if the batch had been consumed.
+  void AttachPool(MemPool* pool);
+
+  // Hand the rows of the scanner to the scan node.
+  void AddFinalRowBatch();
+
+  HdfsScanNode* scan_node_;
+  RuntimeState* state_;
+  ScannerContext* context_;
+  ScannerContext::Stream* stream_;
+
+  // Data returned by FillByteBuffer() that has not been parsed yet.
+  char* byte_buffer_ptr_;
+  char* byte_buffer_end_;
+  int byte_buffer_read_size_;
+
+  // Unused, the replay does not codegen.
+  void* codegen_fn_;
+
+ private:
+  // Skip to the first tuple of a range that does not start the file. Sets
+  // *tuple_found to false if the range has no tuple start.
+  Status FindFirstTuple(bool* tuple_found);
+
+  // Parse the rest of the range, or only one tuple if past_scan_range is set.
+  // Sets *num_tuples to the tuples completed.
+  Status ProcessRange(int* num_tuples, bool past_scan_range);
+
+  // Read past the end of the range to finish the last tuple.
+  Status FinishScanRange();
+
+  // Parse up to max_tuples tuples from the byte buffer. Returns the number of
+  // tuples completed.
+  int ParseTuples(int max_tuples);
+
+  void AddRow(const char* data, int len);
+
+  // Line delimiter of the partition.
+  char tuple_delim_;
+
+  // Start of a tuple continued in the next buffer.
+  std::string partial_tuple_;
+
+  // Hashes of the rows not handed to the scan node yet.
+  std::vector<uint64_t> row_hashes_;
+};
+
+}
+
+#endif
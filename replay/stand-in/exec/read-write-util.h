@@ -0,0 +1,27 @@
+// Copyright (c) 2012 Cloudera, Inc. All rights reserved.
+
+#ifndef IMPALA_EXEC_READ_WRITE_UTIL_H
+#define IMPALA_EXEC_READ_WRITE_UTIL_H
+
+#include <string>
+#include <stdint.h>
+
+namespace impala {
+
+// Big endian integer decoding, as Impala's ReadWriteUtil.
+class ReadWriteUtil {
+ public:
+  template <typename T>
+  static T GetInt(const uint8_t* buffer) {
+    T value = 0;
+    for (int i = 0; i < sizeof(T); ++i) value = (value << 8) | buffer[i];
+    return value;
+  }
+
+  // Returns the bytes in hex, 16 per line.
+  static std::string HexDump(const uint8_t* buf, int len);
+};
+
+}
+
+#endif
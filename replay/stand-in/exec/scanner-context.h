@@ -0,0 +1,119 @@
+// Copyright (c) 2012 Cloudera, Inc. All rights reserved.
+
+#ifndef IMPALA_EXEC_SCANNER_CONTEXT_H
+#define IMPALA_EXEC_SCANNER_CONTEXT_H
+
+#include <deque>
+#include <stdint.h>
+#include "common/status.h"
+#include "runtime/disk-io-mgr.h"
+
+namespace impala {
+
+class HdfsPartitionDescriptor;
+class HdfsScanNode;
+class RuntimeState;
+
+// Stand-in for the ScannerContext of one scan range. Its stream reads the local file
+// with pread() in I/O buffers of --replay_io_buffer_size up to the end of the scan
+// range, and in buffers of the read past size beyond it, the way the DiskIoMgr and
+// the context hand data to a scanner. The buffers are charged to the query's memory
+// limits until the scanner has moved past them.
+class ScannerContext {
+ public:
+  class Stream {
+   public:
+    // Returns up to requested_len bytes from the current offset in *buffer, reading
+    // past the end of the scan range if needed. Fewer bytes are returned only at
+    // the end of the file. *buffer is valid until the next call on the stream.
+    // *eos is set if the stream is at or past the end of the scan range.
+    bool GetBytes(int requested_len, uint8_t** buffer, int* out_len, bool* eos,
+        Status* status);
+
+    // Reads a big endian int32.
+    bool ReadInt(int32_t* val, Status* status);
+
+    // Skips 'length' bytes. The skipped bytes are still read from the file.
+    bool SkipBytes(int64_t length, Status* status);
+
+    bool eosr() const { return file_offset_ >= scan_range_end_; }
+    bool eof() const { return file_offset_ >= file_length_; }
+    int64_t file_offset() const { return file_offset_; }
+    const char* filename() const { return scan_range_->file(); }
+    DiskIoMgr::ScanRange* scan_range() { return scan_range_; }
+    bool compact_data() const;
+
+    // Size of the reads past the end of the scan range.
+    void set_read_past_buffer_size(int size) { read_past_buffer_size_ = size; }
+
+    // Bytes read from the file so far.
+    int64_t bytes_read() const { return bytes_read_; }
+
+   private:
+    friend class ScannerContext;
+
+    static const int DEFAULT_READ_PAST_SIZE = 1024;
+
+    struct Buffer {
+      int64_t offset;
+      int64_t len;
+      uint8_t* data;
+    };
+
+    Stream(ScannerContext* parent, DiskIoMgr::ScanRange* scan_range,
+        int64_t file_length);
+
+    // Reads buffers until the data up to 'end' has been read.
+    Status ReadBuffers(int64_t end);
+
+    // Frees the buffers that end at or before the current offset, and the copy
+    // made for the previous GetBytes() call.
+    void ReleaseBuffers();
+
+    void FreeBuffer(uint8_t* data, int64_t len);
+
+    ScannerContext* parent_;
+    DiskIoMgr::ScanRange* scan_range_;
+    int64_t scan_range_end_;
+    int64_t file_length_;
+    int fd_;
+
+    int64_t file_offset_;
+
+    // End of the data read from the file. Buffers are read sequentially.
+    int64_t read_offset_;
+    std::deque<Buffer> buffers_;
+
+    // Contiguous copy of a GetBytes() result that spans buffers.
+    uint8_t* boundary_buffer_;
+    int boundary_buffer_len_;
+
+    int read_past_buffer_size_;
+    int64_t bytes_read_;
+  };
+
+  ScannerContext(RuntimeState* state, HdfsScanNode* scan_node,
+      HdfsPartitionDescriptor* partition_desc, DiskIoMgr::ScanRange* scan_range);
+  ~ScannerContext();
+
+  Stream* GetStream() { return &stream_; }
+
+  // Returns true if the scan node is done and the scanner should stop.
+  bool cancelled() const;
+
+  // Release the I/O buffers. Called by the scanner when it is closed.
+  void Close();
+
+  HdfsPartitionDescriptor* partition_descriptor() { return partition_desc_; }
+
+ private:
+  RuntimeState* state_;
+  HdfsScanNode* scan_node_;
+  HdfsPartitionDescriptor* partition_desc_;
+  Stream stream_;
+  bool closed_;
+};
+
+}
+
+#endif
@@ -0,0 +1,9 @@
+// Copyright (c) 2012 Cloudera, Inc. All rights reserved.
+
+#ifndef IMPALA_EXEC_SCANNER_CONTEXT_INLINE_H
+#define IMPALA_EXEC_SCANNER_CONTEXT_INLINE_H
+
+// The stand-in stream is implemented in stand-in-exec.cc.
+#include "exec/scanner-context.h"
+
+#endif
@@ -0,0 +1,49 @@
+// Copyright (c) 2012 Cloudera, Inc. All rights reserved.
+
+#ifndef IMPALA_EXPRS_EXPR_H
+#define IMPALA_EXPRS_EXPR_H
+
+#include <string>
+#include <vector>
+#include "gen-cpp/Opcodes_types.h"
+#include "runtime/string-value.h"
+
+namespace impala {
+
+class TupleRow;
+
+// Stand-in for an expr tree node. The replay only builds the conjuncts the LZO
+// prefilter looks at: a predicate over a slot and a constant string.
+class Expr {
+ public:
+  virtual ~Expr() {
+    for (int i = 0; i < children_.size(); ++i) delete children_[i];
+  }
+
+  TExprOpcode::type op() const { return op_; }
+  int GetNumChildren() const { return children_.size(); }
+  Expr* GetChild(int i) const { return children_[i]; }
+  bool IsConstant() const { return is_constant_; }
+
+  // Returns the value of a constant string expr, NULL otherwise. The replay does
+  // not evaluate exprs on rows.
+  virtual void* GetValue(TupleRow* row) { return NULL; }
+
+  // Returns a string literal. The caller owns the result.
+  static Expr* CreateStringLiteral(const std::string& value);
+
+  // Returns a predicate 'op' on two exprs, which it takes ownership of.
+  static Expr* CreatePredicate(TExprOpcode::type op, Expr* lhs, Expr* rhs);
+
+ protected:
+  Expr(TExprOpcode::type op, bool is_constant)
+    : op_(op), is_constant_(is_constant) { }
+
+  TExprOpcode::type op_;
+  bool is_constant_;
+  std::vector<Expr*> children_;
+};
+
+}
+
+#endif
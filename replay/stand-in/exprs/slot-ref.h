@@ -0,0 +1,23 @@
+// Copyright (c) 2012 Cloudera, Inc. All rights reserved.
+
+#ifndef IMPALA_EXPRS_SLOT_REF_H
+#define IMPALA_EXPRS_SLOT_REF_H
+
+#include "exprs/expr.h"
+
+namespace impala {
+
+// Reference to a slot of the scanned tuple.
+class SlotRef : public Expr {
+ public:
+  SlotRef(int slot_id) : Expr(TExprOpcode::INVALID_OPCODE, false), slot_id_(slot_id) { }
+
+  int slot_id() const { return slot_id_; }
+
+ private:
+  int slot_id_;
+};
+
+}
+
+#endif
@@ -0,0 +1,33 @@
+// Copyright (c) 2012 Cloudera, Inc. All rights reserved.
+
+#ifndef IMPALA_REPLAY_DESCRIPTORS_TYPES_H
+#define IMPALA_REPLAY_DESCRIPTORS_TYPES_H
+
+namespace impala {
+
+struct THdfsFileFormat {
+  enum type {
+    TEXT,
+    LZO_TEXT,
+    RC_FILE,
+    SEQUENCE_FILE,
+    TREVNI,
+    PARQUETFILE
+  };
+};
+
+struct THdfsCompression {
+  enum type {
+    NONE,
+    DEFAULT,
+    GZIP,
+    DEFLATE,
+    BZIP2,
+    SNAPPY,
+    SNAPPY_BLOCKED
+  };
+};
+
+}
+
+#endif
@@ -0,0 +1,20 @@
+// Copyright (c) 2012 Cloudera, Inc. All rights reserved.
+
+#ifndef IMPALA_REPLAY_OPCODES_TYPES_H
+#define IMPALA_REPLAY_OPCODES_TYPES_H
+
+namespace impala {
+
+// The opcodes of the conjuncts the replay can build. The LZO prefilter looks at
+// LIKE and EQ_STRING_STRING, anything else stands for the rest.
+struct TExprOpcode {
+  enum type {
+    INVALID_OPCODE,
+    LIKE,
+    EQ_STRING_STRING
+  };
+};
+
+}
+
+#endif
@@ -0,0 +1,21 @@
+// Copyright (c) 2012 Cloudera, Inc. All rights reserved.
+
+#ifndef IMPALA_REPLAY_RUNTIME_PROFILE_TYPES_H
+#define IMPALA_REPLAY_RUNTIME_PROFILE_TYPES_H
+
+namespace impala {
+
+struct TCounterType {
+  enum type {
+    UNIT,
+    UNIT_PER_SECOND,
+    CPU_TICKS,
+    BYTES,
+    BYTES_PER_SECOND,
+    TIME_NS
+  };
+};
+
+}
+
+#endif
@@ -0,0 +1,21 @@
+// Copyright (c) 2012 Cloudera, Inc. All rights reserved.
+
+#ifndef IMPALA_REPLAY_TYPES_TYPES_H
+#define IMPALA_REPLAY_TYPES_TYPES_H
+
+#include <stdint.h>
+
+// Stand-in for the generated Thrift types used by the LZO scanner.
+
+namespace impala {
+
+struct TUniqueId {
+  int64_t hi;
+  int64_t lo;
+
+  TUniqueId() : hi(0), lo(0) { }
+};
+
+}
+
+#endif
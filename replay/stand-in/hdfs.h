@@ -0,0 +1,45 @@
+// Copyright (c) 2012 Cloudera, Inc. All rights reserved.
+
+#ifndef IMPALA_REPLAY_HDFS_H
+#define IMPALA_REPLAY_HDFS_H
+
+#include <fcntl.h>
+#include <stdint.h>
+
+// Stand-in for the subset of libhdfs used by the LZO scanner. Paths are local files,
+// see stand-in-hdfs.cc.
+
+typedef int32_t tSize;
+typedef int64_t tOffset;
+typedef void* hdfsFS;
+typedef struct hdfsFile_internal* hdfsFile;
+
+extern "C" {
+// Returns 0 if the path exists, -1 otherwise.
+int hdfsExists(hdfsFS fs, const char* path);
+
+// Opens the path for reading. Only O_RDONLY is supported. Returns NULL on errors.
+hdfsFile hdfsOpenFile(hdfsFS fs, const char* path, int flags, int buffer_size,
+    short replication, tSize block_size);
+
+int hdfsCloseFile(hdfsFS fs, hdfsFile file);
+
+// Reads from the current position. Returns the bytes read, 0 at the end of the file
+// and -1 on errors.
+tSize hdfsRead(hdfsFS fs, hdfsFile file, void* buffer, tSize length);
+
+// Reads at 'position' without moving the current position.
+tSize hdfsPread(hdfsFS fs, hdfsFile file, tOffset position, void* buffer,
+    tSize length);
+}
+
+namespace impala {
+
+// Bytes read through the calls above since the process started, i.e. by the index
+// and block header reads of the scanners. Scan ranges are read by the stand-in
+// ScannerContext and counted there.
+int64_t HdfsBytesRead();
+
+}
+
+#endif
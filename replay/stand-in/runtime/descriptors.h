@@ -0,0 +1,76 @@
+// Copyright (c) 2012 Cloudera, Inc. All rights reserved.
+
+#ifndef IMPALA_RUNTIME_DESCRIPTORS_H
+#define IMPALA_RUNTIME_DESCRIPTORS_H
+
+#include <vector>
+#include <stdint.h>
+
+namespace impala {
+
+enum PrimitiveType {
+  INVALID_TYPE,
+  TYPE_BOOLEAN,
+  TYPE_INT,
+  TYPE_BIGINT,
+  TYPE_DOUBLE,
+  TYPE_STRING
+};
+
+// Stand-in descriptors of a text table with a single string column, the whole
+// line.
+class SlotDescriptor {
+ public:
+  SlotDescriptor(int id, PrimitiveType type, int col_pos)
+    : id_(id), type_(type), col_pos_(col_pos) { }
+
+  int id() const { return id_; }
+  PrimitiveType type() const { return type_; }
+  int col_pos() const { return col_pos_; }
+
+ private:
+  int id_;
+  PrimitiveType type_;
+  int col_pos_;
+};
+
+class DescriptorTbl {
+ public:
+  // Takes ownership of the slots.
+  DescriptorTbl(const std::vector<SlotDescriptor*>& slots) : slots_(slots) { }
+  ~DescriptorTbl();
+
+  // Returns NULL if there is no slot with that id.
+  SlotDescriptor* GetSlotDescriptor(int id) const;
+
+ private:
+  std::vector<SlotDescriptor*> slots_;
+};
+
+class HdfsTableDescriptor {
+ public:
+  HdfsTableDescriptor() { }
+
+  int num_clustering_cols() const { return 0; }
+};
+
+class HdfsPartitionDescriptor {
+ public:
+  HdfsPartitionDescriptor(int64_t id, char line_delim, char field_delim)
+    : id_(id), line_delim_(line_delim), field_delim_(field_delim) { }
+
+  int64_t id() const { return id_; }
+  char line_delim() const { return line_delim_; }
+  char field_delim() const { return field_delim_; }
+  char collection_delim() const { return '\002'; }
+  char escape_char() const { return '\0'; }
+
+ private:
+  int64_t id_;
+  char line_delim_;
+  char field_delim_;
+};
+
+}
+
+#endif
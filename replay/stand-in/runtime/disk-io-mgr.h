@@ -0,0 +1,39 @@
+// Copyright (c) 2012 Cloudera, Inc. All rights reserved.
+
+#ifndef IMPALA_RUNTIME_DISK_IO_MGR_H
+#define IMPALA_RUNTIME_DISK_IO_MGR_H
+
+#include <string>
+#include <stdint.h>
+
+namespace impala {
+
+// Stand-in for the DiskIoMgr scan range. The stand-in HdfsScanNode queues the
+// ranges itself and the ScannerContext reads them.
+class DiskIoMgr {
+ public:
+  class ScanRange {
+   public:
+    ScanRange(const std::string& file, int64_t len, int64_t offset, int disk_id,
+        void* meta_data)
+      : file_(file), len_(len), offset_(offset), disk_id_(disk_id),
+        meta_data_(meta_data) { }
+
+    const char* file() const { return file_.c_str(); }
+    int64_t len() const { return len_; }
+    int64_t offset() const { return offset_; }
+    int disk_id() const { return disk_id_; }
+    void* meta_data() const { return meta_data_; }
+
+   private:
+    std::string file_;
+    int64_t len_;
+    int64_t offset_;
+    int disk_id_;
+    void* meta_data_;
+  };
+};
+
+}
+
+#endif
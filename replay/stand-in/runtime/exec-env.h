@@ -0,0 +1,27 @@
+// Copyright (c) 2012 Cloudera, Inc. All rights reserved.
+
+#ifndef IMPALA_RUNTIME_EXEC_ENV_H
+#define IMPALA_RUNTIME_EXEC_ENV_H
+
+#include "runtime/mem-limit.h"
+#include "util/metrics.h"
+
+namespace impala {
+
+// Process-wide state of the replay: the metrics and the process memory limit. It
+// lives for all passes, like the impalad's.
+class ExecEnv {
+ public:
+  ExecEnv() { }
+
+  Metrics* metrics() { return &metrics_; }
+  MemLimit* mem_limit() { return &mem_limit_; }
+
+ private:
+  Metrics metrics_;
+  MemLimit mem_limit_;
+};
+
+}
+
+#endif
@@ -0,0 +1,10 @@
+// Copyright (c) 2012 Cloudera, Inc. All rights reserved.
+
+#ifndef IMPALA_RUNTIME_HDFS_FS_CACHE_H
+#define IMPALA_RUNTIME_HDFS_FS_CACHE_H
+
+// Included by the LZO scanner. The stand-in scan node hands out the hdfsFS of the
+// local file system itself.
+#include <hdfs.h>
+
+#endif
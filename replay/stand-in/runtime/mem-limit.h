@@ -0,0 +1,41 @@
+// Copyright (c) 2012 Cloudera, Inc. All rights reserved.
+
+#ifndef IMPALA_RUNTIME_MEM_LIMIT_H
+#define IMPALA_RUNTIME_MEM_LIMIT_H
+
+#include <vector>
+#include <stdint.h>
+
+namespace impala {
+
+// Stand-in for Impala's MemLimit. Tracks the consumption and its peak; a limit of
+// -1 never runs out.
+class MemLimit {
+ public:
+  MemLimit(int64_t byte_limit = -1)
+    : limit_(byte_limit), consumption_(0), peak_consumption_(0) { }
+
+  // Consume 'bytes', or release them if 'bytes' is negative.
+  void Consume(int64_t bytes);
+
+  bool LimitExceeded() const { return limit_ >= 0 && consumption_ > limit_; }
+
+  int64_t limit() const { return limit_; }
+  int64_t consumption() const { return consumption_; }
+  int64_t peak_consumption() const { return peak_consumption_; }
+
+  // Consume 'bytes' on all of 'limits'.
+  static void UpdateLimits(int64_t bytes, std::vector<MemLimit*>* limits);
+
+  // Returns true if any of 'limits' is exceeded.
+  static bool LimitExceeded(const std::vector<MemLimit*>& limits);
+
+ private:
+  int64_t limit_;
+  volatile int64_t consumption_;
+  volatile int64_t peak_consumption_;
+};
+
+}
+
+#endif
@@ -0,0 +1,38 @@
+// Copyright (c) 2012 Cloudera, Inc. All rights reserved.
+
+#ifndef IMPALA_RUNTIME_MEM_POOL_H
+#define IMPALA_RUNTIME_MEM_POOL_H
+
+#include <vector>
+#include <stdint.h>
+
+namespace impala {
+
+class MemLimit;
+
+// Stand-in for Impala's MemPool. Every allocation is its own chunk, charged to the
+// pool's limits until FreeAll() or the pool is destroyed.
+class MemPool {
+ public:
+  // 'limits' may be NULL. It must outlive the pool.
+  MemPool(std::vector<MemLimit*>* limits);
+  ~MemPool();
+
+  uint8_t* Allocate(int size);
+
+  // Frees all chunks. The peak is kept.
+  void FreeAll();
+
+  int64_t total_allocated_bytes() const { return total_allocated_bytes_; }
+  int64_t peak_allocated_bytes() const { return peak_allocated_bytes_; }
+
+ private:
+  std::vector<MemLimit*>* limits_;
+  std::vector<uint8_t*> chunks_;
+  int64_t total_allocated_bytes_;
+  int64_t peak_allocated_bytes_;
+};
+
+}
+
+#endif
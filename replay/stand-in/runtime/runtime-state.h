@@ -0,0 +1,59 @@
+// Copyright (c) 2012 Cloudera, Inc. All rights reserved.
+
+#ifndef IMPALA_RUNTIME_RUNTIME_STATE_H
+#define IMPALA_RUNTIME_RUNTIME_STATE_H
+
+#include <string>
+#include <vector>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include "common/object-pool.h"
+#include "gen-cpp/Types_types.h"
+#include "runtime/descriptors.h"
+#include "runtime/exec-env.h"
+#include "runtime/mem-limit.h"
+
+namespace impala {
+
+// Stand-in for the state of one fragment instance, i.e. of one replay pass.
+class RuntimeState {
+ public:
+  // The fragment's memory is charged to a query limit and the process limit of
+  // 'exec_env'.
+  RuntimeState(ExecEnv* exec_env, const TUniqueId& fragment_instance_id,
+      bool abort_on_error);
+
+  ExecEnv* exec_env() { return exec_env_; }
+  ObjectPool* obj_pool() { return &obj_pool_; }
+  const DescriptorTbl& desc_tbl() const { return *desc_tbl_; }
+  std::vector<MemLimit*>* mem_limits() { return &mem_limits_; }
+  MemLimit* query_mem_limit() { return &query_mem_limit_; }
+  const TUniqueId& fragment_instance_id() const { return fragment_instance_id_; }
+  bool abort_on_error() const { return abort_on_error_; }
+
+  // Errors logged by the scanners, as in Impala they do not fail the query.
+  bool LogHasSpace();
+  void LogError(const std::string& error);
+  std::vector<std::string> errors();
+
+ private:
+  // Errors kept at most.
+  static const int MAX_ERRORS = 100;
+
+  ExecEnv* exec_env_;
+  boost::scoped_ptr<DescriptorTbl> desc_tbl_;
+  MemLimit query_mem_limit_;
+  std::vector<MemLimit*> mem_limits_;
+  // Objects in the pool release memory against the limits, so it is destroyed
+  // first.
+  ObjectPool obj_pool_;
+  TUniqueId fragment_instance_id_;
+  bool abort_on_error_;
+
+  boost::mutex error_lock_;
+  std::vector<std::string> errors_;
+};
+
+}
+
+#endif
@@ -0,0 +1,8 @@
+// Copyright (c) 2012 Cloudera, Inc. All rights reserved.
+
+#ifndef IMPALA_RUNTIME_STRING_BUFFER_H
+#define IMPALA_RUNTIME_STRING_BUFFER_H
+
+// Included by the LZO scanner header. The scanner does not use StringBuffer.
+
+#endif
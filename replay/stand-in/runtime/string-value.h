@@ -0,0 +1,19 @@
+// Copyright (c) 2012 Cloudera, Inc. All rights reserved.
+
+#ifndef IMPALA_RUNTIME_STRING_VALUE_H
+#define IMPALA_RUNTIME_STRING_VALUE_H
+
+namespace impala {
+
+// The in-memory value of a string slot.
+struct StringValue {
+  char* ptr;
+  int len;
+
+  StringValue() : ptr(0), len(0) { }
+  StringValue(char* ptr, int len) : ptr(ptr), len(len) { }
+};
+
+}
+
+#endif
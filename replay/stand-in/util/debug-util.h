@@ -0,0 +1,16 @@
+// Copyright (c) 2012 Cloudera, Inc. All rights reserved.
+
+#ifndef IMPALA_UTIL_DEBUG_UTIL_H
+#define IMPALA_UTIL_DEBUG_UTIL_H
+
+#include <string>
+#include "gen-cpp/Types_types.h"
+
+namespace impala {
+
+// Returns the id as <hi>:<lo> in hex, as Impala prints query and fragment ids.
+std::string PrintId(const TUniqueId& id);
+
+}
+
+#endif
@@ -0,0 +1,38 @@
+// Copyright (c) 2012 Cloudera, Inc. All rights reserved.
+
+#ifndef IMPALA_UTIL_HASH_UTIL_H
+#define IMPALA_UTIL_HASH_UTIL_H
+
+#include <stdint.h>
+#include <nmmintrin.h>
+
+namespace impala {
+
+// Stand-in for Impala's HashUtil with its SSE4.2 CRC hash. The blocks sampled by
+// the replay are those of an impalad whose HashUtil::Hash() is the same.
+class HashUtil {
+ public:
+  static uint32_t CrcHash(const void* data, int32_t bytes, uint32_t hash) {
+    uint32_t words = bytes / sizeof(uint32_t);
+    bytes = bytes % sizeof(uint32_t);
+    const uint32_t* p = reinterpret_cast<const uint32_t*>(data);
+    while (words--) {
+      hash = _mm_crc32_u32(hash, *p);
+      ++p;
+    }
+    const uint8_t* s = reinterpret_cast<const uint8_t*>(p);
+    while (bytes--) {
+      hash = _mm_crc32_u8(hash, *s);
+      ++s;
+    }
+    return hash;
+  }
+
+  static uint32_t Hash(const void* data, int32_t bytes, uint32_t seed) {
+    return CrcHash(data, bytes, seed);
+  }
+};
+
+}
+
+#endif
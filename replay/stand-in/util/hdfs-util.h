@@ -0,0 +1,16 @@
+// Copyright (c) 2012 Cloudera, Inc. All rights reserved.
+
+#ifndef IMPALA_UTIL_HDFS_UTIL_H
+#define IMPALA_UTIL_HDFS_UTIL_H
+
+#include <string>
+
+namespace impala {
+
+// Returns 'prefix' followed by 'file' and the description of errno.
+std::string AppendHdfsErrorMessage(const std::string& prefix,
+    const std::string& file);
+
+}
+
+#endif
@@ -0,0 +1,96 @@
+// Copyright (c) 2012 Cloudera, Inc. All rights reserved.
+
+#ifndef IMPALA_UTIL_METRICS_H
+#define IMPALA_UTIL_METRICS_H
+
+#include <map>
+#include <sstream>
+#include <string>
+#include <stdint.h>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace impala {
+
+// Stand-in for the impalad's metric registry. The replay prints the metrics after
+// each pass instead of serving them on /metrics.
+class Metrics {
+ public:
+  class Metric {
+   public:
+    virtual ~Metric() { }
+    virtual std::string ToString() = 0;
+  };
+
+  template <typename T>
+  class PrimitiveMetric : public Metric {
+   public:
+    PrimitiveMetric(const T& value) : value_(value) { }
+
+    void Increment(const T& delta) {
+      boost::lock_guard<boost::mutex> l(lock_);
+      value_ += delta;
+    }
+
+    void Update(const T& value) {
+      boost::lock_guard<boost::mutex> l(lock_);
+      value_ = value;
+    }
+
+    T value() {
+      boost::lock_guard<boost::mutex> l(lock_);
+      return value_;
+    }
+
+    virtual std::string ToString() {
+      std::stringstream ss;
+      ss << value();
+      return ss.str();
+    }
+
+   private:
+    boost::mutex lock_;
+    T value_;
+  };
+
+  typedef PrimitiveMetric<int64_t> IntMetric;
+
+  Metrics() { }
+
+  ~Metrics() {
+    for (MetricMap::iterator it = metrics_.begin(); it != metrics_.end(); ++it) {
+      delete it->second;
+    }
+  }
+
+  template <typename T>
+  PrimitiveMetric<T>* CreateAndRegisterPrimitiveMetric(const std::string& key,
+      const T& value) {
+    PrimitiveMetric<T>* metric = new PrimitiveMetric<T>(value);
+    boost::lock_guard<boost::mutex> l(lock_);
+    Metric*& registered = metrics_[key];
+    delete registered;
+    registered = metric;
+    return metric;
+  }
+
+  // Returns the values of all metrics, by name.
+  std::map<std::string, std::string> GetValues() {
+    std::map<std::string, std::string> values;
+    boost::lock_guard<boost::mutex> l(lock_);
+    for (MetricMap::iterator it = metrics_.begin(); it != metrics_.end(); ++it) {
+      values[it->first] = it->second->ToString();
+    }
+    return values;
+  }
+
+ private:
+  typedef std::map<std::string, Metric*> MetricMap;
+
+  boost::mutex lock_;
+  MetricMap metrics_;
+};
+
+}
+
+#endif
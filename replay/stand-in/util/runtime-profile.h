@@ -0,0 +1,74 @@
+// Copyright (c) 2012 Cloudera, Inc. All rights reserved.
+
+#ifndef IMPALA_UTIL_RUNTIME_PROFILE_H
+#define IMPALA_UTIL_RUNTIME_PROFILE_H
+
+#include <map>
+#include <string>
+#include <stdint.h>
+#include <boost/thread/mutex.hpp>
+#include "gen-cpp/RuntimeProfile_types.h"
+#include "util/stopwatch.h"
+
+#define ADD_COUNTER(profile, name, type) (profile)->AddCounter(name, type)
+#define ADD_TIMER(profile, name) (profile)->AddCounter(name, TCounterType::TIME_NS)
+#define COUNTER_UPDATE(c, v) (c)->Update(v)
+#define COUNTER_SET(c, v) (c)->Set(v)
+#define SCOPED_TIMER_CONCAT2(a, b) a##b
+#define SCOPED_TIMER_CONCAT(a, b) SCOPED_TIMER_CONCAT2(a, b)
+#define SCOPED_TIMER(c) \
+  ScopedTimer SCOPED_TIMER_CONCAT(scoped_timer_, __LINE__)(c)
+
+namespace impala {
+
+// Stand-in for the counters of an exec node's profile. Counters are shared by the
+// scanners of the node and updated with atomics.
+class RuntimeProfile {
+ public:
+  class Counter {
+   public:
+    Counter(TCounterType::type type) : type_(type), value_(0) { }
+
+    void Update(int64_t delta) { __sync_fetch_and_add(&value_, delta); }
+    void Set(int64_t value) { value_ = value; }
+    int64_t value() const { return value_; }
+    TCounterType::type type() const { return type_; }
+
+   private:
+    TCounterType::type type_;
+    volatile int64_t value_;
+  };
+
+  RuntimeProfile() { }
+  ~RuntimeProfile();
+
+  // Returns the counter called 'name', adding it if it does not exist yet.
+  Counter* AddCounter(const std::string& name, TCounterType::type type);
+
+  // Returns all counters by name.
+  const std::map<std::string, Counter*>& counters() const { return counters_; }
+
+ private:
+  boost::mutex lock_;
+  std::map<std::string, Counter*> counters_;
+};
+
+// Adds the time until it goes out of scope to a TIME_NS counter.
+class ScopedTimer {
+ public:
+  ScopedTimer(RuntimeProfile::Counter* counter) : counter_(counter) {
+    watch_.Start();
+  }
+
+  ~ScopedTimer() {
+    if (counter_ != NULL) counter_->Update(watch_.ElapsedTime());
+  }
+
+ private:
+  RuntimeProfile::Counter* counter_;
+  MonotonicStopWatch watch_;
+};
+
+}
+
+#endif
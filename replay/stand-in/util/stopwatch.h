@@ -0,0 +1,47 @@
+// Copyright (c) 2012 Cloudera, Inc. All rights reserved.
+
+#ifndef IMPALA_UTIL_STOPWATCH_H
+#define IMPALA_UTIL_STOPWATCH_H
+
+#include <time.h>
+#include <stdint.h>
+
+namespace impala {
+
+// Stopwatch on CLOCK_MONOTONIC, as Impala's.
+class MonotonicStopWatch {
+ public:
+  MonotonicStopWatch() : start_(0), total_time_(0), running_(false) { }
+
+  void Start() {
+    if (running_) return;
+    start_ = Now();
+    running_ = true;
+  }
+
+  void Stop() {
+    if (!running_) return;
+    total_time_ += Now() - start_;
+    running_ = false;
+  }
+
+  // Returns the time in ns, including the current run if the watch is running.
+  uint64_t ElapsedTime() const {
+    return running_ ? total_time_ + Now() - start_ : total_time_;
+  }
+
+  static uint64_t Now() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+  }
+
+ private:
+  uint64_t start_;
+  uint64_t total_time_;
+  bool running_;
+};
+
+}
+
+#endif